@@ -1,6 +1,6 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
@@ -23,69 +23,543 @@
 #include "fs.h"
 #include "buf.h"
 
+#define NBUCKET 13
+
+// Beyond the NBUF static buffers, the cache grows a page of
+// buffers at a time from kalloc(), up to NBUFMAX buffers, and
+// bshrink() gives unused pages back when kalloc() runs out.
+#define NPERCHUNK ((PGSIZE - sizeof(void*)) / sizeof(struct buf))
+
+// The log pins the blocks it holds in the cache until they are
+// installed, so before an operation starts, breserve() makes
+// sure the cache has a buffer for each block it may log, beyond
+// BSLACK buffers for blocks not logged, and bshrink() keeps
+// those. The NBUF static buffers always have room for one
+// operation of MAXOPBLOCKS.
+#define BSLACK (NBUF - 2*MAXOPBLOCKS)
+
+struct bufchunk {
+  struct bufchunk *next;
+  struct buf buf[NPERCHUNK];
+};
+
+// Replacement policy. The default is 2Q (Johnson and Shasha,
+// VLDB '94), which keeps a block read just once, as by cat or
+// grep streaming through a file, from pushing out blocks used
+// over and over, such as inodes, bitmaps and directories:
+//  - a block read in goes on a FIFO queue, A1, and further
+//    hits there don't move it, so a scan only cycles A1;
+//  - when A1 grows past a quarter of the cache, its oldest
+//    block is evicted first, and remembered, by number only,
+//    on a ghost list of NGHOST blocks;
+//  - a block read in again while on the ghost list goes on
+//    an LRU queue, Am, instead, and stays there until Am
+//    has to give up a buffer.
+// Building with BCACHELRU=1 puts every block on Am instead.
+//
+// Each buffer is on one queue, by b->queue: the free queue,
+// of buffers that hold no block, A1 or Am. Eviction takes the
+// first unused buffer from the head of the free queue, or else
+// A1 or Am, and so costs O(1) apart from buffers in use that it
+// passes over. Hits take only a bucket lock, not bcache.lock,
+// so they can't reorder Am; instead a hit marks the buffer
+// used, and eviction gives a used buffer on Am another turn at
+// the tail (the clock algorithm, an approximation of LRU). A
+// buffer in use is also moved to the tail.
+// The ghost list is a ring, with hash chains through it
+// for lookups.
+#define NGHOST (NBUFMAX/2)
+#define NGHOSTHASH 257
+
+enum { LRU, TWOQ };
+#ifdef BCACHELRU
+static const int policy = LRU;
+#else
+static const int policy = TWOQ;
+#endif
+
+// Buffers are hashed by (dev, blockno) into NBUCKET buckets,
+// each a list with its own lock, so that lookups of different
+// blocks don't contend. bcache.lock only serializes evictions,
+// growing and shrinking:
+// a process that misses takes it and then, at most one at a
+// time, the bucket lock of each buffer it considers evicting,
+// and that of the block it wants. Only an
+// evicting process ever holds two bucket locks, so the order
+// in which it takes them can't deadlock. A buffer always
+// sits in the bucket its (dev, blockno) hashes to; free
+// buffers, with dev 0 and blockno 0, in that of (0, 0).
+struct bufq {
+  struct buf *head;
+  struct buf *tail;
+  int n;
+};
+
 struct {
   struct spinlock lock;
   struct buf buf[NBUF];
 
-  // Linked list of all buffers, through prev/next.
-  // Sorted by how recently the buffer was used.
-  // head.next is most recent, head.prev is least.
-  struct buf head;
+  // protected by bcache.lock:
+  struct bufchunk *chunks; // pages of buffers from kalloc()
+  int nbuf;                // buffers in the cache
+  int reserved;            // buffers breserve()d by the log
+  int nwait;               // processes waiting in bget()
+  struct bufq q[BQ_AM+1];  // eviction queues, by b->queue
+  struct {
+    uint dev;              // 0 if the slot is empty
+    uint blockno;
+    int next;              // next in its hash chain, or -1
+  } ghost[NGHOST];         // blocks evicted from A1, a ring
+  int ghostnext;           // where the next one goes
+  int ghosthash[NGHOSTHASH]; // first in each hash chain, or -1
+  uint64 misses;
+  uint64 ghosthits;        // misses found on the ghost list
+  uint64 grows;            // pages allocated
+  uint64 shrinks;          // pages given back
+
+  struct {
+    struct spinlock lock;
+    struct buf head;  // circular list, through prev/next
+    uint64 hits[BQ_AM+1];  // by queue
+  } bucket[NBUCKET];
 } bcache;
 
+static int
+hash(uint dev, uint blockno)
+{
+  return (dev * 31 + blockno) % NBUCKET;
+}
+
+static void
+bucketinsert(int i, struct buf *b)
+{
+  b->next = bcache.bucket[i].head.next;
+  b->prev = &bcache.bucket[i].head;
+  bcache.bucket[i].head.next->prev = b;
+  bcache.bucket[i].head.next = b;
+}
+
+static void
+bucketremove(struct buf *b)
+{
+  b->next->prev = b->prev;
+  b->prev->next = b->next;
+}
+
+// Add b at the tail of eviction queue i. Caller holds bcache.lock.
+static void
+qappend(int i, struct buf *b)
+{
+  struct bufq *q = &bcache.q[i];
+
+  b->queue = i;
+  b->qnext = 0;
+  b->qprev = q->tail;
+  if(q->tail)
+    q->tail->qnext = b;
+  else
+    q->head = b;
+  q->tail = b;
+  q->n++;
+}
+
+// Take b off its eviction queue. Caller holds bcache.lock.
+static void
+qremove(struct buf *b)
+{
+  struct bufq *q = &bcache.q[b->queue];
+
+  if(b->qprev)
+    b->qprev->qnext = b->qnext;
+  else
+    q->head = b->qnext;
+  if(b->qnext)
+    b->qnext->qprev = b->qprev;
+  else
+    q->tail = b->qprev;
+  b->qprev = b->qnext = 0;
+  q->n--;
+}
+
 void
 binit(void)
 {
   struct buf *b;
+  int i;
 
   initlock(&bcache.lock, "bcache");
+  for(i = 0; i < NBUCKET; i++){
+    initlock(&bcache.bucket[i].lock, "bcache.bucket");
+    bcache.bucket[i].head.prev = &bcache.bucket[i].head;
+    bcache.bucket[i].head.next = &bcache.bucket[i].head;
+  }
 
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
   for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
     initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    bucketinsert(hash(0, 0), b);
+    qappend(BQ_NONE, b);
   }
+  for(i = 0; i < NGHOSTHASH; i++)
+    bcache.ghosthash[i] = -1;
+  bcache.nbuf = NBUF;
 }
 
-// Look through buffer cache for block on device dev.
-// If not found, allocate a buffer.
-// In either case, return locked buffer.
-static struct buf*
-bget(uint dev, uint blockno)
+// Add a page of buffers to the cache, on the free queue.
+// Returns 1, or 0 if out of memory. Caller holds bcache.lock.
+static int
+bgrow(void)
 {
+  struct bufchunk *c;
   struct buf *b;
+  int k;
+
+  // kalloc() doesn't call bshrink() while we hold a spin
+  // lock, bcache.lock here.
+  if((c = kalloc()) == 0)
+    return 0;
+  memset(c, 0, sizeof(*c));
+  for(b = c->buf; b < c->buf + NPERCHUNK; b++)
+    initsleeplock(&b->lock, "buffer");
+  k = hash(0, 0);
+  acquire(&bcache.bucket[k].lock);
+  for(b = c->buf; b < c->buf + NPERCHUNK; b++){
+    bucketinsert(k, b);
+    qappend(BQ_NONE, b);
+  }
+  release(&bcache.bucket[k].lock);
+  c->next = bcache.chunks;
+  bcache.chunks = c;
+  bcache.nbuf += NPERCHUNK;
+  bcache.grows++;
+  return 1;
+}
+
+// Give back to kalloc() the page of buffers, none of them in
+// use, that was least recently used, unless the log has
+// reserved its buffers. Called by kalloc() when it has no
+// free pages, and holds no spin lock. Returns 1 if it freed a
+// page, 0 if not.
+int
+bshrink(void)
+{
+  struct bufchunk *c, **cp, **best;
+  struct buf *b;
+  uint64 last, bestlast;
+  int i;
+
+  acquire(&bcache.lock);
+  if(bcache.nbuf - NPERCHUNK < BSLACK + bcache.reserved){
+    release(&bcache.lock);
+    return 0;
+  }
+  // only a holder of bcache.lock takes more than one bucket
+  // lock, so taking them all, in order, is safe.
+  for(i = 0; i < NBUCKET; i++)
+    acquire(&bcache.bucket[i].lock);
+
+  best = 0;
+  bestlast = 0;
+  for(cp = &bcache.chunks; (c = *cp) != 0; cp = &c->next){
+    last = 0;
+    for(b = c->buf; b < c->buf + NPERCHUNK; b++){
+      if(b->refcnt != 0)
+        break;
+      if(b->lastuse > last)
+        last = b->lastuse;
+    }
+    if(b == c->buf + NPERCHUNK && (best == 0 || last < bestlast)){
+      best = cp;
+      bestlast = last;
+    }
+  }
+  c = 0;
+  if(best){
+    c = *best;
+    *best = c->next;
+    for(b = c->buf; b < c->buf + NPERCHUNK; b++){
+      bucketremove(b);
+      qremove(b);
+      freelock(&b->lock.lk);
+    }
+    bcache.nbuf -= NPERCHUNK;
+    bcache.shrinks++;
+  }
+
+  for(i = 0; i < NBUCKET; i++)
+    release(&bcache.bucket[i].lock);
+  release(&bcache.lock);
+  if(c)
+    kfree(c);
+  return c != 0;
+}
+
+// Reserve buffers for the log to pin n more blocks in, growing
+// the cache as need be; if there aren't n, take as many as there
+// are, but at least min. Returns how many, or -1 if there aren't
+// min, memory being short or the cache at NBUFMAX, and then the
+// log has to commit, to unpin blocks, before it can have them.
+// Called with log.lock held.
+int
+breserve(int n, int min)
+{
+  int room;
 
   acquire(&bcache.lock);
+  while(bcache.nbuf - BSLACK - bcache.reserved < n &&
+        bcache.nbuf + NPERCHUNK <= NBUFMAX && bgrow())
+    ;
+  room = bcache.nbuf - BSLACK - bcache.reserved;
+  if(room > n)
+    room = n;
+  if(room < min)
+    room = -1;
+  else
+    bcache.reserved += room;
+  release(&bcache.lock);
+  return room;
+}
 
-  // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+// Give back n buffers breserve()d by the log.
+void
+bunreserve(int n)
+{
+  acquire(&bcache.lock);
+  bcache.reserved -= n;
+  if(bcache.reserved < 0)
+    panic("bunreserve");
+  release(&bcache.lock);
+}
+
+// Look for block (dev, blockno) in bucket i, whose lock must be
+// held, and take a reference to it, counting a hit.
+static struct buf*
+bfind(int i, uint dev, uint blockno)
+{
+  struct buf *b;
+
+  for(b = bcache.bucket[i].head.next; b != &bcache.bucket[i].head; b = b->next){
     if(b->dev == dev && b->blockno == blockno){
       b->refcnt++;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
+      b->used = 1;
+      bcache.bucket[i].hits[b->queue]++;
+      return b;
+    }
+  }
+  return 0;
+}
+
+// Look along eviction queue i for an unused buffer, and return
+// it, off the queue, with the lock of its bucket, *vk, held; or
+// 0 if there is none. Buffers in use, and used ones on Am, go
+// to the tail. Caller holds bcache.lock.
+static struct buf*
+qvictim(int i, int *vk)
+{
+  struct buf *b;
+  int n, k;
+
+  for(n = bcache.q[i].n; n > 0; n--){
+    b = bcache.q[i].head;
+    k = hash(b->dev, b->blockno);
+    acquire(&bcache.bucket[k].lock);
+    if(b->refcnt == 0 && (i != BQ_AM || !b->used)){
+      qremove(b);
+      *vk = k;
       return b;
     }
+    b->used = 0;
+    release(&bcache.bucket[k].lock);
+    qremove(b);
+    qappend(i, b);
   }
+  return 0;
+}
 
-  // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
+// Find an unused buffer to evict: a free one, or else one from
+// A1 if A1 holds more than a quarter of the cache, or else Am.
+// Returns it off its queue, with the lock of its bucket, *vk,
+// held; or 0 if every buffer is in use.
+// Caller holds bcache.lock.
+static struct buf*
+bvictim(int *vk)
+{
+  struct buf *b;
+  int first, second;
+
+  if(bcache.q[BQ_A1].n > bcache.nbuf / 4){
+    first = BQ_A1;
+    second = BQ_AM;
+  } else {
+    first = BQ_AM;
+    second = BQ_A1;
+  }
+  if((b = qvictim(BQ_NONE, vk)) == 0 &&
+     (b = qvictim(first, vk)) == 0)
+    b = qvictim(second, vk);
+  return b;
+}
+
+static int
+ghostkey(uint dev, uint blockno)
+{
+  return (dev * 31 + blockno) % NGHOSTHASH;
+}
+
+// Unlink ghost list slot i from its hash chain, and empty it.
+// Caller holds bcache.lock.
+static void
+ghostunlink(int i)
+{
+  int *ip;
+
+  ip = &bcache.ghosthash[ghostkey(bcache.ghost[i].dev, bcache.ghost[i].blockno)];
+  while(*ip != i)
+    ip = &bcache.ghost[*ip].next;
+  *ip = bcache.ghost[i].next;
+  bcache.ghost[i].dev = 0;
+}
+
+// Remember block (dev, blockno), just evicted from A1,
+// in place of the oldest on the ghost list.
+// Caller holds bcache.lock.
+static void
+ghostadd(uint dev, uint blockno)
+{
+  int i = bcache.ghostnext, k = ghostkey(dev, blockno);
+
+  if(bcache.ghost[i].dev)
+    ghostunlink(i);
+  bcache.ghost[i].dev = dev;
+  bcache.ghost[i].blockno = blockno;
+  bcache.ghost[i].next = bcache.ghosthash[k];
+  bcache.ghosthash[k] = i;
+  bcache.ghostnext = (i + 1) % NGHOST;
+}
+
+// If block (dev, blockno) is on the ghost list, take it off
+// and return 1; else return 0. Caller holds bcache.lock.
+static int
+ghosttake(uint dev, uint blockno)
+{
+  int i;
+
+  for(i = bcache.ghosthash[ghostkey(dev, blockno)]; i >= 0; i = bcache.ghost[i].next){
+    if(bcache.ghost[i].dev == dev && bcache.ghost[i].blockno == blockno){
+      ghostunlink(i);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Make b, unused and off its queue, or just allocated, hold
+// block (dev, blockno), and put it on the queue the policy
+// calls for. Caller holds bcache.lock, and b's bucket lock if any.
+static void
+bassign(struct buf *b, uint dev, uint blockno)
+{
+  int queue;
+
+  if(b->queue == BQ_A1 && b->valid)
+    ghostadd(b->dev, b->blockno);
+
+  queue = policy == LRU ? BQ_AM : BQ_A1;
+  if(policy == TWOQ && ghosttake(dev, blockno)){
+    bcache.ghosthits++;
+    queue = BQ_AM;
+  }
+  qappend(queue, b);
+  b->used = 0;
+  b->lastuse = r_time();
+  b->dev = dev;
+  b->blockno = blockno;
+  b->valid = 0;
+  b->refcnt = 1;
+}
+
+// Look through buffer cache for block on device dev, and
+// if not found, allocate a buffer, unless wait is 0 and none
+// is free; then return 0. Return the buffer referenced, but
+// not locked, and set *cached to whether it held the block.
+static struct buf*
+bref(uint dev, uint blockno, int wait, int *cached)
+{
+  struct buf *b;
+  int k, vk;
+
+  *cached = 1;
+  k = hash(dev, blockno);
+  acquire(&bcache.bucket[k].lock);
+  b = bfind(k, dev, blockno);
+  release(&bcache.bucket[k].lock);
+  if(b)
+    return b;
+
+  // Not cached. Only evicting processes add buffers to a
+  // bucket, so once bcache.lock is held, a second look
+  // tells for sure whether another miss cached the block
+  // in the meantime.
+  acquire(&bcache.lock);
+  for(;;){
+    acquire(&bcache.bucket[k].lock);
+    b = bfind(k, dev, blockno);
+    release(&bcache.bucket[k].lock);
+    if(b){
       release(&bcache.lock);
-      acquiresleep(&b->lock);
       return b;
     }
+
+    // rather than evict a cached block, use a new buffer
+    // if there is no free one and the cache may grow.
+    if(bcache.q[BQ_NONE].n == 0 && bcache.nbuf + NPERCHUNK <= NBUFMAX)
+      bgrow();
+    if((b = bvictim(&vk)) != 0)
+      break;
+    if(!wait){
+      release(&bcache.lock);
+      return 0;
+    }
+
+    // every buffer is in use, or pinned by the log: wait
+    // for one to be released, and look again. count this
+    // process in nwait first, and then look once more, so
+    // that a buffer released after the look above is either
+    // found or seen by bfreed() to have a waiter.
+    bcache.nwait++;
+    if((b = bvictim(&vk)) != 0){
+      bcache.nwait--;
+      break;
+    }
+    sleep(&bcache.nwait, &bcache.lock);
+    bcache.nwait--;
+  }
+
+  bcache.misses++;
+  bassign(b, dev, blockno);
+  if(vk != k){
+    bucketremove(b);
+    release(&bcache.bucket[vk].lock);
+    acquire(&bcache.bucket[k].lock);
+    bucketinsert(k, b);
   }
-  panic("bget: no buffers");
+  release(&bcache.bucket[k].lock);
+  release(&bcache.lock);
+  *cached = 0;
+  return b;
+}
+
+// Look through buffer cache for block on device dev.
+// If not found, allocate a buffer.
+// In either case, return locked buffer.
+static struct buf*
+bget(uint dev, uint blockno)
+{
+  struct buf *b;
+  int cached;
+
+  b = bref(dev, blockno, 1, &cached);
+  acquiresleep(&b->lock);
+  return b;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -102,6 +576,33 @@ bread(uint dev, uint blockno)
   return b;
 }
 
+// Return n locked bufs, in bs, with the contents of blocks
+// blockno to blockno+n-1, n at most MAXRUN, reading each run
+// of them not already cached with a single disk request.
+// Taking the locks in block order keeps two breadn()s of
+// overlapping runs from deadlocking.
+void
+breadn(uint dev, uint blockno, int n, struct buf **bs)
+{
+  int i, j;
+
+  if(n < 1 || n > MAXRUN)
+    panic("breadn");
+  for(i = 0; i < n; i++)
+    bs[i] = bget(dev, blockno + i);
+  for(i = 0; i < n; i = j){
+    if(bs[i]->valid){
+      j = i + 1;
+      continue;
+    }
+    for(j = i + 1; j < n && !bs[j]->valid; j++)
+      ;
+    virtio_disk_rwn(&bs[i], j - i, 0);
+    for(; i < j; i++)
+      bs[i]->valid = 1;
+  }
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
@@ -111,8 +612,84 @@ bwrite(struct buf *b)
   virtio_disk_rw(b, 1);
 }
 
+// Write the n locked bufs in bs, which must hold consecutive
+// blocks, n at most MAXRUN, with a single disk request.
+void
+bwriten(struct buf **bs, int n)
+{
+  int i;
+
+  if(n < 1 || n > MAXRUN)
+    panic("bwriten");
+  for(i = 0; i < n; i++){
+    if(!holdingsleep(&bs[i]->lock))
+      panic("bwriten");
+    if(bs[i]->dev != bs[0]->dev || bs[i]->blockno != bs[0]->blockno + i)
+      panic("bwriten: not consecutive");
+  }
+  virtio_disk_rwn(bs, n, 1);
+}
+
+// Write the contents of the n bufs in bs, all on one device,
+// to the n consecutive blocks starting at blockno, rather than
+// to their own blocks, queueing a disk request per MAXRUN of
+// them before waiting for any. The bufs needn't be locked, but
+// no one may change them meanwhile: the log uses this for the
+// blocks it pins, during a commit, when no op is running.
+// The cache still maps each buf to its own block, so a cached
+// copy of a destination block goes stale.
+void
+bwriteat(struct buf **bs, int n, uint blockno)
+{
+  int i;
+
+  for(i = 0; i < n; i++){
+    if(bs[i]->dev != bs[0]->dev)
+      panic("bwriteat: dev");
+  }
+  virtio_disk_writeat(bs, n, blockno);
+}
+
+// b's last reference is gone: wake any bget() waiting for a
+// buffer. Before its last look at b's refcnt, under the same
+// bucket lock that the caller just dropped, a waiter counts
+// itself in nwait, so it either saw b unused or shows up in
+// nwait here. It keeps bcache.lock from then until it is
+// asleep, so once this has taken and dropped bcache.lock, the
+// wakeup can't be lost. The wakeup comes after dropping it,
+// so that no one holds bcache.lock while taking other
+// processes' p->locks (see kalloc()).
+static void
+bfreed(void)
+{
+  if(__atomic_load_n(&bcache.nwait, __ATOMIC_RELAXED) == 0)
+    return;
+  acquire(&bcache.lock);
+  release(&bcache.lock);
+  wakeup(&bcache.nwait);
+}
+
+// Drop a reference to b, whose lock has been released.
+static void
+bunref(struct buf *b)
+{
+  int k = hash(b->dev, b->blockno);
+  int freed = 0;
+
+  acquire(&bcache.bucket[k].lock);
+  b->refcnt--;
+  if (b->refcnt == 0) {
+    // no one is waiting for it.
+    b->lastuse = r_time();
+    freed = 1;
+  }
+  release(&bcache.bucket[k].lock);
+  if(freed)
+    bfreed();
+}
+
 // Release a locked buffer.
-// Move to the head of the most-recently-used list.
+// Stamp it, for bshrink() to find the least recently used page.
 void
 brelse(struct buf *b)
 {
@@ -120,34 +697,111 @@ brelse(struct buf *b)
     panic("brelse");
 
   releasesleep(&b->lock);
+  bunref(b);
+}
 
-  acquire(&bcache.lock);
-  b->refcnt--;
-  if (b->refcnt == 0) {
-    // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-  }
-  
-  release(&bcache.lock);
+// Called by virtio_disk_intr() when the read started by
+// breadahead() is done, to release b in its issuer's place.
+void
+bdone(struct buf *b)
+{
+  b->valid = 1;
+  releasesleep(&b->lock);
+  bunref(b);
+}
+
+// Start reading block (dev, blockno) into the cache, unless
+// it is there already, and return without waiting for it.
+// Returns -1 if no buffer is free or the disk's queue is full:
+// read-ahead is not worth waiting for.
+int
+breadahead(uint dev, uint blockno)
+{
+  struct buf *b;
+  int cached;
+
+  if((b = bref(dev, blockno, 0, &cached)) == 0)
+    return -1;
+  if(cached){
+    // being read, or read already; don't wait for its lock.
+    bunref(b);
+    return 0;
+  }
+  acquiresleep(&b->lock);
+  if(b->valid){
+    // a bread() got to it first.
+    brelse(b);
+    return 0;
+  }
+  if(virtio_disk_read_async(b) < 0){
+    brelse(b);
+    return -1;
+  }
+  // b stays locked, and referenced, until bdone(): a
+  // bread() of it meanwhile waits in acquiresleep().
+  return 0;
 }
 
 void
 bpin(struct buf *b) {
-  acquire(&bcache.lock);
+  int k = hash(b->dev, b->blockno);
+
+  acquire(&bcache.bucket[k].lock);
   b->refcnt++;
-  release(&bcache.lock);
+  release(&bcache.bucket[k].lock);
 }
 
 void
 bunpin(struct buf *b) {
-  acquire(&bcache.lock);
+  int k = hash(b->dev, b->blockno);
+  int freed;
+
+  acquire(&bcache.bucket[k].lock);
   b->refcnt--;
-  release(&bcache.lock);
+  freed = b->refcnt == 0;
+  release(&bcache.bucket[k].lock);
+  if(freed)
+    bfreed();
+}
+
+// Format the cache's size and hit rates into buf.
+// Called by the statistics device; see stats.c.
+int
+statsbcache(char *buf, int sz)
+{
+  uint64 hits[BQ_AM+1], all;
+  int i, q, n;
+
+  for(q = 0; q <= BQ_AM; q++){
+    hits[q] = 0;
+    for(i = 0; i < NBUCKET; i++)
+      hits[q] += bcache.bucket[i].hits[q];
+  }
+  all = hits[BQ_A1] + hits[BQ_AM];
+  n = snprintf(buf, sz, "bcache: %s, %l hits, %l misses (%d%% hits), %d buffers, "
+               "%l pages grown, %l shrunk\n", policy == LRU ? "lru" : "2q",
+               all, bcache.misses,
+               all + bcache.misses ? (int)(all * 100 / (all + bcache.misses)) : 0,
+               bcache.nbuf, bcache.grows, bcache.shrinks);
+  if(policy == TWOQ)
+    n += snprintf(buf + n, sz - n, "bcache.2q: %l hits on a1, %l on am, "
+                  "%l misses on ghost list, %d buffers on a1\n",
+                  hits[BQ_A1], hits[BQ_AM], bcache.ghosthits, bcache.q[BQ_A1].n);
+  return n;
 }
 
+void
+statsbcachereset(void)
+{
+  int i, q;
 
+  acquire(&bcache.lock);
+  bcache.misses = bcache.ghosthits = bcache.grows = bcache.shrinks = 0;
+  release(&bcache.lock);
+  for(i = 0; i < NBUCKET; i++){
+    acquire(&bcache.bucket[i].lock);
+    for(q = 0; q <= BQ_AM; q++)
+      bcache.bucket[i].hits[q] = 0;
+    release(&bcache.bucket[i].lock);
+  }
+}
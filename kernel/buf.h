@@ -5,8 +5,18 @@ struct buf {
   uint blockno;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev; // LRU cache list
+  int queue;        // BQ_*; see bio.c. set with bcache.lock held
+  int used;         // hit since eviction last passed it over
+  uint64 lastuse;   // time CSR, for choosing a page to shrink
+  uint64 loggen;    // log group that has this block, if current
+  struct buf *prev; // hash bucket list
   struct buf *next;
+  struct buf *qprev; // eviction queue, b->queue
+  struct buf *qnext;
   uchar data[BSIZE];
 };
 
+// buffer cache queues; see bio.c.
+#define BQ_NONE 0   // holds no block: free
+#define BQ_A1   1   // read in once
+#define BQ_AM   2   // read in again soon after eviction
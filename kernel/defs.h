@@ -4,8 +4,11 @@ struct file;
 struct inode;
 struct pipe;
 struct proc;
+struct rwlock;
+struct seqlock;
 struct spinlock;
 struct sleeplock;
+struct waitq;
 struct stat;
 struct superblock;
 
@@ -14,8 +17,18 @@ void            binit(void);
 struct buf*     bread(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            breadn(uint, uint, int, struct buf**);
+void            bwriten(struct buf**, int);
+void            bwriteat(struct buf**, int, uint);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
+int             breadahead(uint, uint);
+void            bdone(struct buf*);
+int             bshrink(void);
+int             breserve(int, int);
+void            bunreserve(int);
+int             statsbcache(char*, int);
+void            statsbcachereset(void);
 
 // console.c
 void            consoleinit(void);
@@ -50,6 +63,7 @@ int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, int, uint64, uint, uint);
+uint            ireadahead(struct inode*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
@@ -68,7 +82,9 @@ void            kinit(void);
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
 void            begin_op(void);
+int             begin_opn(int);
 void            end_op(void);
+void            logsync(void);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
@@ -99,13 +115,25 @@ void            procinit(void);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 void            sleep(void*, struct spinlock*);
+int             sleeptimeout(void*, struct spinlock*, uint64);
 void            userinit(void);
+void            kthread(void (*)(void), char*);
 int             wait(uint64);
 void            wakeup(void*);
+void            wakeproc(struct proc*);
+void            sleepq(struct waitq*, struct spinlock*);
+void            sleepqn(struct waitq*, struct spinlock*, int);
+int             wakeupq(struct waitq*, int);
+int             wakeupqn(struct waitq*, int, int);
+void            wakeupsync(void*);
 void            yield(void);
+int             timeslice(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+void            usyscall_ticks(uint);
+int             rtsched(int, int);
+void            rtcharge(int);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -113,15 +141,34 @@ void            swtch(struct context*, struct context*);
 // spinlock.c
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
+int             holdingany(void);
 void            initlock(struct spinlock*, char*);
+void            freelock(struct spinlock*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
+int             statslock(char*, int);
+void            statsreset(void);
+
+// rwlock.c
+void            initrwlock(struct rwlock*, char*);
+void            acquireread(struct rwlock*);
+void            releaseread(struct rwlock*);
+void            acquirewrite(struct rwlock*);
+void            releasewrite(struct rwlock*);
+int             holdingwrite(struct rwlock*);
+void            initseqlock(struct seqlock*, char*);
+void            acquireseq(struct seqlock*);
+void            releaseseq(struct seqlock*);
+uint            readseqbegin(struct seqlock*);
+int             readseqretry(struct seqlock*, uint);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
+int             statssleep(char*, int);
+void            statssleepreset(void);
 void            initsleeplock(struct sleeplock*, char*);
 
 // string.c
@@ -133,6 +180,12 @@ int             strlen(const char*);
 int             strncmp(const char*, const char*, uint);
 char*           strncpy(char*, const char*, int);
 
+// sprintf.c
+int             snprintf(char*, int, char*, ...);
+
+// stats.c
+void            statsinit(void);
+
 // syscall.c
 void            argint(int, int*);
 int             argstr(int, char*, int);
@@ -141,11 +194,31 @@ int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
 
+// prof.c
+void            profuser(struct proc*);
+void            profkernel(uint64, uint64*);
+void            kprofinit(void);
+
+// timer.c
+void            hrtimerinit(void);
+void            timerinithart(void);
+uint64          nanotime(void);
+void            timerset(uint64);
+int             timerintr(void);
+void            timeradd(struct proc*, uint64);
+void            timerdel(struct proc*);
+int             sleepuntil(uint64);
+
+// trace.c
+void            traceinit(void);
+void            syscall_hist(int, uint64);
+void            syscall_trace(struct proc*, int, uint64*, uint64, uint64);
+
 // trap.c
 extern uint     ticks;
 void            trapinit(void);
 void            trapinithart(void);
-extern struct spinlock tickslock;
+extern struct seqlock tickseq;
 void            usertrapret(void);
 
 // uart.c
@@ -183,6 +256,9 @@ void            plic_complete(int);
 // virtio_disk.c
 void            virtio_disk_init(void);
 void            virtio_disk_rw(struct buf *, int);
+void            virtio_disk_rwn(struct buf **, int, int);
+void            virtio_disk_writeat(struct buf **, int, uint);
+int             virtio_disk_read_async(struct buf *);
 void            virtio_disk_intr(void);
 
 // number of elements in fixed-size array
@@ -126,6 +126,11 @@ exec(char *path, char **argv)
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
+  if(p->ioring){
+    // the new image starts without a syscall ring.
+    uvmunmap(oldpagetable, IORING, 1, 1);
+    p->ioring = 0;
+  }
   proc_freepagetable(oldpagetable, oldsz);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
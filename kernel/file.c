@@ -101,6 +101,41 @@ filestat(struct file *f, uint64 addr)
   return -1;
 }
 
+// If a read of n bytes at f->off continues where the last
+// read of f ended, start reading a window of blocks beyond
+// those it covers, so that they arrive while the caller works
+// through the earlier ones. The blocks the read covers are
+// left to readi(), which reads runs of them in one disk
+// request each, rather than one at a time. The window doubles
+// with each sequential read, up to RAMAX blocks, and closes
+// on a seek. Caller holds f->ip->lock.
+static void
+readahead(struct file *f, uint n)
+{
+  uint first, end;
+
+  if(n == 0)
+    return;
+  if(f->off == f->raoff){
+    f->rawin = f->rawin ? f->rawin * 2 : RAMIN;
+    if(f->rawin > RAMAX)
+      f->rawin = RAMAX;
+  } else {
+    f->rawin = 0;
+    f->ranext = 0;
+  }
+  f->raoff = f->off + n;
+  if(f->rawin == 0)
+    return;
+
+  first = (f->off + n - 1) / BSIZE + 1;
+  end = first + f->rawin;
+  if(f->ranext > first)
+    first = f->ranext;
+  if(first < end)
+    f->ranext = first + ireadahead(f->ip, first, end - first);
+}
+
 // Read from file f.
 // addr is a user virtual address.
 int
@@ -119,6 +154,7 @@ fileread(struct file *f, uint64 addr, int n)
     r = devsw[f->major].read(1, addr, n);
   } else if(f->type == FD_INODE){
     ilock(f->ip);
+    readahead(f, n);
     if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
       f->off += r;
     iunlock(f->ip);
@@ -129,6 +165,17 @@ fileread(struct file *f, uint64 addr, int n)
   return r;
 }
 
+// Most blocks writing n bytes to a file can change:
+// the data blocks, 2 of them partly, the indirect block,
+// the bitmap blocks covering the new blocks, and the i-node.
+static int
+writeblocks(int n)
+{
+  int nb = n / BSIZE + 2;
+
+  return nb + 1 + ((nb + 1) / BPB + 2) + 1;
+}
+
 // Write to file f.
 // addr is a user virtual address.
 int
@@ -146,20 +193,23 @@ filewrite(struct file *f, uint64 addr, int n)
       return -1;
     ret = devsw[f->major].write(1, addr, n);
   } else if(f->type == FD_INODE){
-    // write a few blocks at a time to avoid exceeding
-    // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
+    // each transaction reserves log space for the
+    // blocks it may write; a quarter of the log at a time
+    // leaves room for other operations.
     // this really belongs lower down, since writei()
     // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+    int max = (LOGSIZE / 4) * BSIZE;
     int i = 0;
     while(i < n){
       int n1 = n - i;
       if(n1 > max)
         n1 = max;
 
-      begin_op();
+      r = begin_opn(writeblocks(n1));
+      // short of log space or memory, the log may give
+      // this transaction fewer blocks.
+      while(writeblocks(n1) > r)
+        n1 -= BSIZE;
       ilock(f->ip);
       if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
         f->off += r;
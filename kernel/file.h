@@ -6,6 +6,10 @@ struct file {
   struct pipe *pipe; // FD_PIPE
   struct inode *ip;  // FD_INODE and FD_DEVICE
   uint off;          // FD_INODE
+  // read-ahead state, FD_INODE, guarded by ip->lock; see fileread().
+  uint raoff;        // where a sequential read would start next
+  uint rawin;        // read-ahead window, in blocks; 0 if not sequential
+  uint ranext;       // first block not yet read ahead
   short major;       // FD_DEVICE
 };
 
@@ -38,3 +42,5 @@ struct devsw {
 extern struct devsw devsw[];
 
 #define CONSOLE 1
+#define KPROF   2
+#define STATS   3
@@ -15,6 +15,7 @@
 #include "param.h"
 #include "stat.h"
 #include "spinlock.h"
+#include "rwlock.h"
 #include "proc.h"
 #include "sleeplock.h"
 #include "fs.h"
@@ -164,17 +165,20 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The itable.lock spin-lock protects the allocation of itable
-// entries. Since ip->ref indicates whether an entry is free,
+// The itable.lock reader-writer lock protects the allocation of
+// itable entries. Since ip->ref indicates whether an entry is free,
 // and ip->dev and ip->inum indicate which i-node an entry
 // holds, one must hold itable.lock while using any of those fields.
+// Lookups of cached inodes, the common case, hold it only for
+// reading and increment ip->ref atomically; allocating an entry
+// and dropping a reference (iput) hold it for writing.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
 struct {
-  struct spinlock lock;
+  struct rwlock lock;
   struct inode inode[NINODE];
 } itable;
 
@@ -183,7 +187,7 @@ iinit()
 {
   int i = 0;
   
-  initlock(&itable.lock, "itable");
+  initrwlock(&itable.lock, "itable");
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&itable.inode[i].lock, "inode");
   }
@@ -248,14 +252,25 @@ iget(uint dev, uint inum)
 {
   struct inode *ip, *empty;
 
-  acquire(&itable.lock);
-
   // Is the inode already in the table?
+  acquireread(&itable.lock);
+  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
+    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+      __sync_fetch_and_add(&ip->ref, 1);
+      releaseread(&itable.lock);
+      return ip;
+    }
+  }
+  releaseread(&itable.lock);
+
+  // No; look again for writing, since another process may
+  // have added it in between.
+  acquirewrite(&itable.lock);
   empty = 0;
   for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
     if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
       ip->ref++;
-      release(&itable.lock);
+      releasewrite(&itable.lock);
       return ip;
     }
     if(empty == 0 && ip->ref == 0)    // Remember empty slot.
@@ -271,7 +286,7 @@ iget(uint dev, uint inum)
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
-  release(&itable.lock);
+  releasewrite(&itable.lock);
 
   return ip;
 }
@@ -281,9 +296,9 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&itable.lock);
-  ip->ref++;
-  release(&itable.lock);
+  acquireread(&itable.lock);
+  __sync_fetch_and_add(&ip->ref, 1);
+  releaseread(&itable.lock);
   return ip;
 }
 
@@ -336,7 +351,7 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
-  acquire(&itable.lock);
+  acquirewrite(&itable.lock);
 
   if(ip->ref == 1 && ip->valid && ip->nlink == 0){
     // inode has no links and no other references: truncate and free.
@@ -345,7 +360,7 @@ iput(struct inode *ip)
     // so this acquiresleep() won't block (or deadlock).
     acquiresleep(&ip->lock);
 
-    release(&itable.lock);
+    releasewrite(&itable.lock);
 
     itrunc(ip);
     ip->type = 0;
@@ -354,11 +369,11 @@ iput(struct inode *ip)
 
     releasesleep(&ip->lock);
 
-    acquire(&itable.lock);
+    acquirewrite(&itable.lock);
   }
 
   ip->ref--;
-  release(&itable.lock);
+  releasewrite(&itable.lock);
 }
 
 // Common idiom: unlock, then put.
@@ -464,33 +479,75 @@ stati(struct inode *ip, struct stat *st)
   st->size = ip->size;
 }
 
+// Start reading n blocks of ip, from block bn on, into the
+// buffer cache without waiting for them; stop at the end of
+// the file. Returns the number of blocks started or already
+// cached, fewer than n if the disk's queue filled up.
+// Caller must hold ip->lock.
+uint
+ireadahead(struct inode *ip, uint bn, uint n)
+{
+  uint i, addr, nblock;
+
+  nblock = (ip->size + BSIZE - 1) / BSIZE;
+  for(i = 0; i < n && bn + i < nblock; i++){
+    // blocks below ip->size are all allocated, so this
+    // bmap() only looks them up.
+    if((addr = bmap(ip, bn + i)) == 0)
+      break;
+    if(breadahead(ip->dev, addr) < 0)
+      break;
+  }
+  return i;
+}
+
+// Map blocks bn, bn+1, ... of ip, at most max of them, and
+// return how many in a row are consecutive on disk from *addr
+// on; 0 if block bn can't be mapped.
+static uint
+bmaprun(struct inode *ip, uint bn, uint max, uint *addr)
+{
+  uint n;
+
+  if((*addr = bmap(ip, bn)) == 0)
+    return 0;
+  for(n = 1; n < max && bmap(ip, bn + n) == *addr + n; n++)
+    ;
+  return n;
+}
+
 // Read data from inode.
 // Caller must hold ip->lock.
 // If user_dst==1, then dst is a user virtual address;
 // otherwise, dst is a kernel address.
+// Blocks that are consecutive on disk are read together
+// with breadn().
 int
 readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 {
-  uint tot, m;
-  struct buf *bp;
+  uint tot, m, addr, bn, nb, i;
+  struct buf *bs[MAXRUN];
 
   if(off > ip->size || off + n < off)
     return 0;
   if(off + n > ip->size)
     n = ip->size - off;
 
-  for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    uint addr = bmap(ip, off/BSIZE);
-    if(addr == 0)
-      break;
-    bp = bread(ip->dev, addr);
-    m = min(n - tot, BSIZE - off%BSIZE);
-    if(either_copyout(user_dst, dst, bp->data + (off % BSIZE), m) == -1) {
-      brelse(bp);
-      tot = -1;
+  for(tot=0; tot<n; ){
+    bn = off/BSIZE;
+    nb = bmaprun(ip, bn, min((off + n - tot - 1)/BSIZE - bn + 1, MAXRUN), &addr);
+    if(nb == 0)
       break;
+    breadn(ip->dev, addr, nb, bs);
+    for(i = 0; i < nb; i++, tot+=m, off+=m, dst+=m){
+      m = min(n - tot, BSIZE - off%BSIZE);
+      if(either_copyout(user_dst, dst, bs[i]->data + (off % BSIZE), m) == -1) {
+        for(; i < nb; i++)
+          brelse(bs[i]);
+        return -1;
+      }
+      brelse(bs[i]);
     }
-    brelse(bp);
   }
   return tot;
 }
@@ -502,31 +559,36 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 // Returns the number of bytes successfully written.
 // If the return value is less than the requested n,
 // there was an error of some kind.
+// As in readi(), consecutive blocks are read together.
 int
 writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 {
-  uint tot, m;
-  struct buf *bp;
+  uint tot, m, addr, bn, nb, i;
+  struct buf *bs[MAXRUN];
 
   if(off > ip->size || off + n < off)
     return -1;
   if(off + n > MAXFILE*BSIZE)
     return -1;
 
-  for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    uint addr = bmap(ip, off/BSIZE);
-    if(addr == 0)
-      break;
-    bp = bread(ip->dev, addr);
-    m = min(n - tot, BSIZE - off%BSIZE);
-    if(either_copyin(bp->data + (off % BSIZE), user_src, src, m) == -1) {
-      brelse(bp);
+  for(tot=0; tot<n; ){
+    bn = off/BSIZE;
+    nb = bmaprun(ip, bn, min((off + n - tot - 1)/BSIZE - bn + 1, MAXRUN), &addr);
+    if(nb == 0)
       break;
+    breadn(ip->dev, addr, nb, bs);
+    for(i = 0; i < nb; i++, tot+=m, off+=m, src+=m){
+      m = min(n - tot, BSIZE - off%BSIZE);
+      if(either_copyin(bs[i]->data + (off % BSIZE), user_src, src, m) == -1) {
+        for(; i < nb; i++)
+          brelse(bs[i]);
+        goto out;
+      }
+      log_write(bs[i]);
+      brelse(bs[i]);
     }
-    log_write(bp);
-    brelse(bp);
   }
-
+out:
   if(off > ip->size)
     ip->size = off;
 
@@ -24,6 +24,27 @@ struct superblock {
 
 #define FSMAGIC 0x10203040
 
+// The log's first block holds a struct logsuper; the rest is a
+// circular journal of transactions, each a struct logdesc and
+// the block numbers it logs, in at most LOGHDR blocks, followed
+// by the logged blocks. Needs param.h.
+#define LOGMAGIC 0x10c10c01
+
+struct logsuper {
+  uint magic;        // LOGMAGIC
+  uint start;        // Journal block of the first transaction to replay
+  uint64 txid;       // Its transaction ID
+};
+
+struct logdesc {
+  uint magic;        // LOGMAGIC
+  int n;             // Number of blocks logged
+  uint64 txid;       // Transaction ID, one more than the last's
+  uint64 cksum;      // Over the logged blocks, then this with cksum 0
+};
+
+#define LOGHDR ((sizeof(struct logdesc) + sizeof(int) * LOGSIZE + BSIZE - 1) / BSIZE)
+
 #define NDIRECT 12
 #define NINDIRECT (BSIZE / sizeof(uint))
 #define MAXFILE (NDIRECT + NINDIRECT)
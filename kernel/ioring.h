@@ -0,0 +1,44 @@
+// Shared-memory rings for batching system calls.
+// Both the kernel and user programs use this header file.
+//
+// ringsetup() maps one struct ioring at IORING in the calling
+// process.  User code fills submission entries at sqtail and
+// advances it; ringenter(n) carries out up to n of them in a
+// single trap, in order, and posts one completion per entry at
+// cqtail.  User code consumes completions by advancing cqhead.
+// The indices only ever increase; use them modulo the ring size.
+
+#define IORING_NSQE 64   // submission ring entries
+#define IORING_NCQE 64   // completion ring entries
+
+#define IORING_OP_READ   1   // read(fd, addr, len)
+#define IORING_OP_WRITE  2   // write(fd, addr, len)
+#define IORING_OP_OPEN   3   // open(addr, flags)
+#define IORING_OP_CLOSE  4   // close(fd)
+#define IORING_OP_FSTAT  5   // fstat(fd, addr)
+
+// submission entry
+struct iosqe {
+  int op;            // IORING_OP_*
+  int fd;
+  uint64 addr;       // user buffer, path, or struct stat
+  int len;
+  int flags;         // open mode
+  uint64 user_data;  // copied to the completion
+};
+
+// completion entry
+struct iocqe {
+  uint64 user_data;
+  int res;           // system call return value
+  int pad;
+};
+
+struct ioring {
+  uint sqhead;  // next submission the kernel takes (kernel writes)
+  uint sqtail;  // next free submission slot (user writes)
+  uint cqhead;  // next completion to consume (user writes)
+  uint cqtail;  // next completion slot (kernel writes)
+  struct iosqe sq[IORING_NSQE];
+  struct iocqe cq[IORING_NCQE];
+};
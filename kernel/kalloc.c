@@ -70,11 +70,17 @@ kalloc(void)
 {
   struct run *r;
 
-  acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
-  release(&kmem.lock);
+  do {
+    acquire(&kmem.lock);
+    r = kmem.freelist;
+    if(r)
+      kmem.freelist = r->next;
+    release(&kmem.lock);
+    // out of pages: take one back from the buffer cache,
+    // unless the caller holds a spin lock, such as a new
+    // process's p->lock in allocproc(): bshrink() takes
+    // bcache.lock, and a bcache.lock holder may take a p->lock.
+  } while(r == 0 && !holdingany() && bshrink());
 
   if(r)
     memset((char*)r, 5, PGSIZE); // fill with junk
@@ -2,10 +2,12 @@
 #include "riscv.h"
 #include "defs.h"
 #include "param.h"
+#include "memlayout.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "proc.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -19,21 +21,52 @@
 // its start and end. Usually begin_op() just increments
 // the count of in-progress FS system calls and returns.
 // But if it thinks the log is close to running out, it
-// sleeps until the last outstanding end_op() commits.
+// sleeps until the next commit.
+//
+// Commits are grouped: end_op() returns without committing,
+// and the log flusher thread commits everything logged so far
+// once no FS system calls are active and either COMMITMS have
+// passed since the first op of the group ended, the log is
+// close to full, or fsync() asks it to. To get there, new
+// begin_op()s wait while a commit is due (log.force).
+//
+// Each begin_op() reserves log space for the blocks its op
+// may write: MAXOPBLOCKS, or as many as begin_opn() says, so
+// that a large file write fits in one transaction. It also
+// reserves buffers for them, since logged blocks stay pinned
+// in the buffer cache until installed; if memory is short, a
+// large write gets fewer blocks, and writes in smaller pieces.
 //
 // The log is a physical re-do log containing disk blocks.
 // The on-disk log format:
-//   header block, containing block #s for block A, B, C, ...
-//   block A
-//   block B
-//   block C
-//   ...
+//   super block, with where in the journal recovery starts
+//   journal:
+//     descriptor blocks, containing block #s for block A, B, C, ...
+//     block A
+//     block B
+//     block C
+//     ...
+//     descriptor blocks for the next transaction, ...
 // Log appends are synchronous.
+//
+// A transaction commits once it is all on disk: the checksum
+// in its descriptor tells recovery whether the transaction is
+// whole, so the descriptor and blocks can be written together,
+// in any order, and there's no header to clear after
+// installing it. Each new
+// transaction follows the last, with the next transaction ID;
+// recovery replays transactions from the super block's start
+// until one is missing or torn. The super block is rewritten,
+// to start at the next transaction, only every LOGSUPERN
+// commits, so that recovery replays no more than that many
+// installed transactions, and when a transaction won't fit
+// before the journal's end and the journal wraps.
 
-// Contents of the header block, used for both the on-disk header block
-// and to keep track in memory of logged block# before commit.
+// A transaction's descriptor, used for both the on-disk
+// descriptor and to keep track in memory of logged block#
+// before commit.
 struct logheader {
-  int n;
+  struct logdesc d;
   int block[LOGSIZE];
 };
 
@@ -42,163 +75,404 @@ struct log {
   int start;
   int size;
   int outstanding; // how many FS sys calls are executing.
+  int reserved;    // log blocks reserved by them.
+  int bufres;      // buffers breserve()d, for those and the logged.
   int committing;  // in commit(), please wait.
+  int force;       // commit as soon as outstanding is 0.
+  uint64 deadline; // time CSR by which to commit, or 0.
+  uint64 gen;      // number of the group being logged.
+  uint64 done;     // number of the last group committed.
   int dev;
+  int jsize;       // blocks in the journal
+  int head;        // journal block of the next transaction
+  uint64 txid;     // ID of the next transaction
+  int nsuper;      // commits since the super block was written
   struct logheader lh;
+  struct buf desc[LOGHDR]; // for writing descriptors
+  // the transaction as written to the journal: the descriptor
+  // bufs just before LOGHDR, then each logged block's buf.
+  struct buf *jbuf[LOGHDR+LOGSIZE];
+  struct waitq wq; // begin_op()s waiting for space or a commit
 };
 struct log log;
 
 static void recover_from_log(void);
 static void commit();
+static void logflusher(void);
 
 void
 initlog(int dev, struct superblock *sb)
 {
-  if (sizeof(struct logheader) >= BSIZE)
-    panic("initlog: too big logheader");
+  int i;
+
+  if (sb->nlog < 1 + LOGHDR + LOGSIZE)
+    panic("initlog: log too small");
 
   initlock(&log.lock, "log");
   log.start = sb->logstart;
   log.size = sb->nlog;
   log.dev = dev;
+  log.jsize = log.size - 1;
+  for (i = 0; i < LOGHDR; i++)
+    log.desc[i].dev = dev;
+  log.gen = 1;
   recover_from_log();
+  kthread(logflusher, "logflush");
+}
+
+#define CKSUMINIT 0xcbf29ce484222325ULL
+
+// Fold n bytes at p into checksum h: FNV-1a, a word at a time.
+static uint64
+cksum(uint64 h, void *p, int n)
+{
+  uint *w = p;
+  int i;
+
+  for (i = 0; i < n / sizeof(uint); i++)
+    h = (h ^ w[i]) * 0x100000001b3ULL;
+  return h;
+}
+
+// Bytes in a descriptor of n blocks, and blocks it fills.
+static int
+descsize(int n)
+{
+  return sizeof(struct logdesc) + sizeof(int) * n;
+}
+
+static int
+hdrblocks(int n)
+{
+  return (descsize(n) + BSIZE - 1) / BSIZE;
+}
+
+// Disk block of journal block j.
+static int
+jblock(int j)
+{
+  return log.start + 1 + j;
+}
+
+// Disk block of the log's copy of the i'th logged block
+// of the transaction at log.head.
+static int
+logdata(int i)
+{
+  return jblock(log.head + hdrblocks(log.lh.d.n) + i);
 }
 
-// Copy committed blocks from log to their home location
+// Fold the descriptor, its checksum taken as 0, into h.
+static uint64
+cksumdesc(uint64 h)
+{
+  uint64 c = log.lh.d.cksum;
+
+  log.lh.d.cksum = 0;
+  h = cksum(h, &log.lh, descsize(log.lh.d.n));
+  log.lh.d.cksum = c;
+  return h;
+}
+
+// Copy committed blocks from log to their home location.
+// Unless recovering, the pinned cached blocks still hold
+// what was logged, so write those rather than read the log.
 static void
 install_trans(int recovering)
 {
-  int tail;
-
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    if(recovering == 0)
-      bunpin(dbuf);
-    brelse(lbuf);
-    brelse(dbuf);
+  int tail, n, i;
+  struct buf *lbuf[MAXRUN], *dbuf[MAXRUN];
+
+  for (tail = 0; tail < log.lh.d.n; tail += n) {
+    // a run of blocks whose homes are consecutive goes
+    // home in one disk request.
+    for(n = 1; n < MAXRUN && tail + n < log.lh.d.n &&
+          log.lh.block[tail+n] == log.lh.block[tail] + n; n++)
+      ;
+    breadn(log.dev, log.lh.block[tail], n, dbuf); // read dsts
+    if(recovering){
+      breadn(log.dev, logdata(tail), n, lbuf); // read log blocks
+      for(i = 0; i < n; i++){
+        memmove(dbuf[i]->data, lbuf[i]->data, BSIZE);  // copy block to dst
+        brelse(lbuf[i]);
+      }
+    }
+    bwriten(dbuf, n);  // write dsts to disk
+    for(i = 0; i < n; i++){
+      if(recovering == 0)
+        bunpin(dbuf[i]);
+      brelse(dbuf[i]);
+    }
   }
 }
 
-// Read the log header from disk into the in-memory log header
+// Write the super block, so that recovery starts
+// at the transaction at log.head.
 static void
-read_head(void)
+write_super(void)
 {
   struct buf *buf = bread(log.dev, log.start);
-  struct logheader *lh = (struct logheader *) (buf->data);
-  int i;
-  log.lh.n = lh->n;
-  for (i = 0; i < log.lh.n; i++) {
-    log.lh.block[i] = lh->block[i];
-  }
+  struct logsuper *ls = (struct logsuper *) (buf->data);
+
+  ls->magic = LOGMAGIC;
+  ls->start = log.head;
+  ls->txid = log.txid;
+  bwrite(buf);
   brelse(buf);
+  log.nsuper = 0;
+}
+
+// Read the descriptor at log.head into the in-memory log
+// header. Returns 1 if it commits transaction log.txid, whole,
+// and 0 if there is no such transaction.
+static int
+read_head(void)
+{
+  struct buf *buf, *lbuf[MAXRUN];
+  uint64 h;
+  int i, k, n, off;
+
+  if (log.head >= log.jsize)
+    return 0;
+  buf = bread(log.dev, jblock(log.head));
+  memmove(&log.lh.d, buf->data, sizeof(log.lh.d));
+  brelse(buf);
+  n = log.lh.d.n;
+  if (log.lh.d.magic != LOGMAGIC || log.lh.d.txid != log.txid ||
+     n < 1 || n > LOGSIZE || log.head + hdrblocks(n) + n > log.jsize)
+    return 0;
+  for (i = 0; i < hdrblocks(n); i++) {
+    buf = bread(log.dev, jblock(log.head + i));
+    off = i * BSIZE;
+    memmove((char*)&log.lh + off, buf->data,
+            descsize(n) - off < BSIZE ? descsize(n) - off : BSIZE);
+    brelse(buf);
+  }
+
+  h = CKSUMINIT;
+  for (off = 0; off < n; off += i) {
+    i = n - off < MAXRUN ? n - off : MAXRUN;
+    breadn(log.dev, logdata(off), i, lbuf);
+    for (k = 0; k < i; k++) {
+      h = cksum(h, lbuf[k]->data, BSIZE);
+      brelse(lbuf[k]);
+    }
+  }
+  return cksumdesc(h) == log.lh.d.cksum;
 }
 
-// Write in-memory log header to disk.
-// This is the true point at which the
-// current transaction commits.
 static void
-write_head(void)
+recover_from_log(void)
 {
   struct buf *buf = bread(log.dev, log.start);
-  struct logheader *hb = (struct logheader *) (buf->data);
-  int i;
-  hb->n = log.lh.n;
-  for (i = 0; i < log.lh.n; i++) {
-    hb->block[i] = log.lh.block[i];
-  }
-  bwrite(buf);
+  struct logsuper *ls = (struct logsuper *) (buf->data);
+  int fresh, n;
+
+  fresh = ls->magic != LOGMAGIC;  // made by mkfs
+  log.head = fresh ? 0 : ls->start;
+  log.txid = fresh ? 1 : ls->txid;
   brelse(buf);
+
+  // replay each whole transaction in order; installing one
+  // that was installed already does no harm.
+  for (n = 0; read_head(); n++) {
+    install_trans(1); // copy from log to disk
+    log.head += hdrblocks(log.lh.d.n) + log.lh.d.n;
+    log.txid++;
+  }
+  log.lh.d.n = 0;
+  if (fresh || n > 0)
+    write_super(); // start the next recovery here
 }
 
+// Give back the buffers reserved beyond what the log may
+// yet pin: the blocks logged and those reserved by ops
+// still running. Caller holds log.lock.
 static void
-recover_from_log(void)
+bufrelease(void)
 {
-  read_head();
-  install_trans(1); // if committed, copy from log to disk
-  log.lh.n = 0;
-  write_head(); // clear the log
+  int n = log.bufres - (log.lh.d.n + log.reserved);
+
+  if(n > 0){
+    bunreserve(n);
+    log.bufres -= n;
+  }
 }
 
-// called at the start of each FS system call.
-void
-begin_op(void)
+// called at the start of an FS system call that
+// writes at most n blocks. reserves room for them in the
+// log and the buffer cache, or, if there's room for only
+// some, for at least MAXOPBLOCKS, and returns how many.
+int
+begin_opn(int n)
 {
+  int min = n < MAXOPBLOCKS ? n : MAXOPBLOCKS;
+  int room;
+
+  if(n > LOGSIZE)
+    panic("begin_opn");
   acquire(&log.lock);
   while(1){
-    if(log.committing){
-      sleep(&log, &log.lock);
-    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
-      // this op might exhaust log space; wait for commit.
-      sleep(&log, &log.lock);
+    room = LOGSIZE - (log.lh.d.n + log.reserved);
+    if(room > n)
+      room = n;
+    if(log.committing || log.force){
+      sleepq(&log.wq, &log.lock);
+    } else if(room < min || (room = breserve(room, min)) < 0){
+      // this op might exhaust log space, or the buffers
+      // to pin its blocks in; commit first.
+      log.force = 1;
+      if(log.outstanding == 0)
+        wakeup(&log.deadline);
+      sleepq(&log.wq, &log.lock);
     } else {
       log.outstanding += 1;
+      log.reserved += room;
+      log.bufres += room;
+      myproc()->logres = room;
       release(&log.lock);
-      break;
+      return room;
     }
   }
 }
 
+// called at the start of each FS system call.
+void
+begin_op(void)
+{
+  begin_opn(MAXOPBLOCKS);
+}
+
 // called at the end of each FS system call.
-// commits if this was the last outstanding operation.
+// leaves the commit to logflusher().
 void
 end_op(void)
 {
-  int do_commit = 0;
-
   acquire(&log.lock);
   log.outstanding -= 1;
+  log.reserved -= myproc()->logres;
   if(log.committing)
     panic("log.committing");
-  if(log.outstanding == 0){
-    do_commit = 1;
-    log.committing = 1;
-  } else {
-    // begin_op() may be waiting for log space,
-    // and decrementing log.outstanding has decreased
-    // the amount of reserved space.
-    wakeup(&log);
+  bufrelease();
+  if(log.lh.d.n > 0 && log.deadline == 0){
+    // first op of the group: start the commit timer.
+    log.deadline = r_time() + COMMITMS * (TIMEFREQ / 1000);
+    wakeup(&log.deadline);
   }
+  if(log.lh.d.n + MAXOPBLOCKS > LOGSIZE)
+    log.force = 1;  // the next op might not fit.
+  // begin_op()s wait only while a commit is due or under
+  // way, so only the flusher, once it has committed, needs
+  // to wake them.
+  if(log.outstanding == 0 && log.force)
+    wakeup(&log.deadline);
   release(&log.lock);
+}
 
-  if(do_commit){
-    // call commit w/o holding locks, since not allowed
-    // to sleep with locks.
-    commit();
-    acquire(&log.lock);
-    log.committing = 0;
-    wakeup(&log);
+// The log flusher thread: commits each group of operations
+// when it is due, in the background.
+static void
+logflusher(void)
+{
+  acquire(&log.lock);
+  for(;;){
+    if(log.deadline && r_time() >= log.deadline)
+      log.force = 1;
+    if(log.force && log.outstanding == 0){
+      log.committing = 1;
+      log.force = 0;
+      log.deadline = 0;
+      // call commit w/o holding locks, since not allowed
+      // to sleep with locks.
+      release(&log.lock);
+      commit();
+      acquire(&log.lock);
+      log.committing = 0;
+      bufrelease(); // nothing is pinned now
+      log.done = log.gen++;
+      // the log is empty again; let every waiter retry.
+      wakeupq(&log.wq, -1);
+      wakeup(&log.done);
+    } else if(log.deadline && !log.force){
+      sleeptimeout(&log.deadline, &log.lock, log.deadline);
+    } else {
+      sleep(&log.deadline, &log.lock);
+    }
+  }
+}
+
+// Wait until every operation that has ended is on disk,
+// committing at once rather than when the timer says.
+void
+logsync(void)
+{
+  uint64 gen;
+
+  acquire(&log.lock);
+  if(log.lh.d.n == 0 && !log.committing){
     release(&log.lock);
+    return;
+  }
+  gen = log.gen;
+  while(log.done < gen){
+    if(!log.committing && !log.force){
+      log.force = 1;
+      if(log.outstanding == 0)
+        wakeup(&log.deadline);
+    }
+    sleep(&log.done, &log.lock);
   }
+  release(&log.lock);
 }
 
-// Copy modified blocks from cache to log.
+// Write the transaction at log.head to the journal: its
+// descriptor, with the checksum of its blocks, and the blocks,
+// straight from the pinned cached copies, so that the log's own
+// blocks are neither read nor cached. No op is running, so no
+// one changes the blocks meanwhile, and they needn't be locked.
+// The descriptor and blocks go to disk in requests all queued
+// at once; once the last is done, the transaction commits.
 static void
 write_log(void)
 {
-  int tail;
+  struct buf **bs;
+  uint64 h = CKSUMINIT;
+  int i, nh, len;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
-    brelse(from);
-    brelse(to);
+  for (i = 0; i < log.lh.d.n; i++)
+    h = cksum(h, log.jbuf[LOGHDR+i]->data, BSIZE);
+  log.lh.d.magic = LOGMAGIC;
+  log.lh.d.txid = log.txid;
+  log.lh.d.cksum = cksumdesc(h);
+  nh = hdrblocks(log.lh.d.n);
+  bs = &log.jbuf[LOGHDR-nh];
+  for (i = 0; i < nh; i++) {
+    bs[i] = &log.desc[i];
+    len = descsize(log.lh.d.n) - i*BSIZE;
+    memmove(bs[i]->data, (char*)&log.lh + i*BSIZE, len < BSIZE ? len : BSIZE);
   }
+  bwriteat(bs, nh + log.lh.d.n, jblock(log.head));
 }
 
 static void
 commit()
 {
-  if (log.lh.n > 0) {
-    write_log();     // Write modified blocks from cache to log
-    write_head();    // Write header to disk -- the real commit
+  int len;
+
+  if (log.lh.d.n > 0) {
+    len = hdrblocks(log.lh.d.n) + log.lh.d.n;
+    if (log.head + len > log.jsize) {
+      // wrap. the transactions before are all installed.
+      log.head = 0;
+      write_super();
+    }
+    write_log();      // Write descriptor and blocks -- the real commit
     install_trans(0); // Now install writes to home locations
-    log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+    log.head += len;
+    log.txid++;
+    log.lh.d.n = 0;
+    if (++log.nsuper >= LOGSUPERN)
+      write_super(); // installed; recovery can start after it
   }
 }
 
@@ -214,23 +488,20 @@ commit()
 void
 log_write(struct buf *b)
 {
-  int i;
-
   acquire(&log.lock);
-  if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
-    panic("too big a transaction");
   if (log.outstanding < 1)
     panic("log_write outside of trans");
 
-  for (i = 0; i < log.lh.n; i++) {
-    if (log.lh.block[i] == b->blockno)   // log absorption
-      break;
-  }
-  log.lh.block[i] = b->blockno;
-  if (i == log.lh.n) {  // Add new block to log?
+  // a block is pinned while in the log, so its buffer
+  // still holds it if it is in the current group.
+  if (b->loggen != log.gen) {  // Add new block to log?
+    if (log.lh.d.n >= LOGSIZE)
+      panic("too big a transaction");
+    log.jbuf[LOGHDR + log.lh.d.n] = b;
+    log.lh.block[log.lh.d.n++] = b->blockno;
+    b->loggen = log.gen;
     bpin(b);
-    log.lh.n++;
-  }
+  }  // else log absorption
   release(&log.lock);
 }
 
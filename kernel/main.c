@@ -20,13 +20,18 @@ main()
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
     procinit();      // process table
+    traceinit();     // syscall trace rings
     trapinit();      // trap vectors
     trapinithart();  // install kernel trap vector
+    timerinithart(); // start this hart's clock ticks
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
+    kprofinit();     // kernel profiler device
+    statsinit();     // lock statistics device
+    hrtimerinit();   // one-shot timers
     virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
     __sync_synchronize();
@@ -38,6 +43,7 @@ main()
     printf("hart %d starting\n", cpuid());
     kvminithart();    // turn on paging
     trapinithart();   // install kernel trap vector
+    timerinithart();  // start this hart's clock ticks
     plicinithart();   // ask PLIC for device interrupts
   }
 
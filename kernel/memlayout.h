@@ -62,6 +62,29 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   IORING (p->ioring, if the process called ringsetup())
+//   USYSCALL (p->usyscall, read-only to the process)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define USYSCALL (TRAPFRAME - PGSIZE)
+#define IORING (USYSCALL - PGSIZE)
+
+#ifndef __ASSEMBLER__
+// kernel-maintained values that user code reads from the
+// USYSCALL page instead of making a system call.
+struct usyscall {
+  int pid;          // Process ID
+  uint ticks;       // copy of ticks, updated by clockintr()
+  uint64 timefreq;  // rate of the time CSR, in Hz
+  uint nvcsw;       // times this process gave up the CPU to wait
+  uint nivcsw;      // times its time slice ran out
+  uint nswitch;     // context switches on all CPUs, updated by clockintr()
+};
+#endif
+
+// rate at which qemu's CLINT advances mtime and the time CSR.
+#define TIMEFREQ 10000000
+
+// cycles between periodic timer interrupts; about 1/10th second.
+#define TICKINTERVAL 1000000
@@ -7,7 +7,18 @@
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
-#define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       2000  // size of file system in blocks
+#define LOGSIZE      2048  // max data blocks in on-disk log
+#define NBUF         (MAXOPBLOCKS*3)  // size of static disk block cache
+#define NBUFMAX      (LOGSIZE+512)  // max buffers, static and from kalloc()
+#define RAMIN         2  // initial read-ahead window, in blocks
+#define RAMAX        32  // max read-ahead window, in blocks
+#define MAXRUN        8  // max blocks in one disk request
+#define COMMITMS     30  // max ms from an FS op's end to its commit
+#define LOGSUPERN    16  // commits between moves of the log's recovery start
+#define FSSIZE       10000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define NKPROF       1024  // samples in the kernel profiler buffer
+#define SLEEPSPIN     200  // max time CSR cycles to spin on a sleeplock
+#define QMIN          1  // shortest time slice, in clock ticks
+#define QMAX          8  // longest time slice, in clock ticks
+#define RTUTILMAX    1000  // max real-time utilization, in 1/1000 CPU
@@ -68,6 +68,7 @@ pipeclose(struct pipe *pi, int writable)
   }
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
+    freelock(&pi->lock);
     kfree((char*)pi);
   } else
     release(&pi->lock);
@@ -86,7 +87,7 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
       return -1;
     }
     if(pi->nwrite == pi->nread + PIPESIZE){ //DOC: pipewrite-full
-      wakeup(&pi->nread);
+      wakeupsync(&pi->nread);
       sleep(&pi->nwrite, &pi->lock);
     } else {
       char ch;
@@ -96,7 +97,9 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
       i++;
     }
   }
-  wakeup(&pi->nread);
+  // the handoff counts only if this writer goes on to
+  // sleep, typically reading the reader's reply.
+  wakeupsync(&pi->nread);
   release(&pi->lock);
 
   return i;
@@ -124,7 +127,7 @@ piperead(struct pipe *pi, uint64 addr, int n)
     if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
       break;
   }
-  wakeup(&pi->nwrite);  //DOC: piperead-wakeup
+  wakeupsync(&pi->nwrite);  //DOC: piperead-wakeup
   release(&pi->lock);
   return i;
 }
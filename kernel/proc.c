@@ -3,6 +3,7 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "defs.h"
 
@@ -12,6 +13,11 @@ struct proc proc[NPROC];
 
 struct proc *initproc;
 
+// wokegen[q] is bumped whenever a process with quantum q < QMAX,
+// one that looks interactive, wakes up; see wakeproc() and
+// timeslice().
+static uint wokegen[QMAX+1];
+
 int nextpid = 1;
 struct spinlock pid_lock;
 
@@ -26,9 +32,21 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
+// admission control for the real-time (EDF) class.
+// the sum of budget/period over all real-time processes
+// may not exceed RTUTILMAX thousandths of a CPU.
+struct {
+  struct spinlock lock;
+  int util;  // admitted utilization, in 1/1000 CPU
+  int n;     // number of real-time processes
+  struct proc *procs[NPROC];  // the real-time processes
+} rt;
+
 // Allocate a page for each process's kernel stack.
 // Map it high in memory, followed by an invalid
 // guard page.
+// Also allocate each process's USYSCALL page, which,
+// like the kernel stack, stays with the proc slot.
 void
 proc_mapstacks(pagetable_t kpgtbl)
 {
@@ -40,6 +58,11 @@ proc_mapstacks(pagetable_t kpgtbl)
       panic("kalloc");
     uint64 va = KSTACK((int) (p - proc));
     kvmmap(kpgtbl, va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
+
+    if((p->usyscall = (struct usyscall *)kalloc()) == 0)
+      panic("kalloc");
+    memset(p->usyscall, 0, PGSIZE);
+    p->usyscall->timefreq = TIMEFREQ;
   }
 }
 
@@ -51,6 +74,7 @@ procinit(void)
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  initlock(&rt.lock, "rt");
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
       p->state = UNUSED;
@@ -124,6 +148,12 @@ allocproc(void)
 found:
   p->pid = allocpid();
   p->state = USED;
+  p->usyscall->pid = p->pid;
+  p->usyscall->ticks = ticks;
+  p->usyscall->nvcsw = 0;
+  p->usyscall->nivcsw = 0;
+  p->quantum = QMIN;
+  p->slice = 0;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -158,6 +188,15 @@ freeproc(struct proc *p)
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
+  if(p->ioring)
+    uvmunmap(p->pagetable, IORING, 1, 1);
+  p->ioring = 0;
+  p->tracemask = 0;
+  if(p->prof)
+    kfree((void*)p->prof);
+  p->prof = 0;
+  p->nprof = 0;
+  p->profon = 0;
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
@@ -168,6 +207,10 @@ freeproc(struct proc *p)
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
+  p->rtperiod = 0;
+  p->rtbudget = 0;
+  p->rtused = 0;
+  p->rtmissed = 0;
   p->state = UNUSED;
 }
 
@@ -202,6 +245,16 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+  // map the usyscall page just below the trapframe page,
+  // read-only, for ulib.c's getpid() and uptime().
+  if(mappages(pagetable, USYSCALL, PGSIZE,
+              (uint64)(p->usyscall), PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
   return pagetable;
 }
 
@@ -212,9 +265,27 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, USYSCALL, 1, 0);
   uvmfree(pagetable, sz);
 }
 
+// Publish a new value of ticks, and the context switch count,
+// in every USYSCALL page. Called by clockintr().
+void
+usyscall_ticks(uint t)
+{
+  struct proc *p;
+  struct cpu *c;
+  uint n = 0;
+
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    n += c->nswitch;
+  for(p = proc; p < &proc[NPROC]; p++){
+    p->usyscall->ticks = t;
+    p->usyscall->nswitch = n;
+  }
+}
+
 // a user program that calls exec("/init")
 // assembled from ../user/initcode.S
 // od -t xC ../user/initcode
@@ -254,6 +325,37 @@ userinit(void)
   release(&p->lock);
 }
 
+// A kernel thread's first scheduling by scheduler()
+// will swtch to kthreadstart.
+static void
+kthreadstart(void)
+{
+  struct proc *p = myproc();
+
+  // Still holding p->lock from scheduler.
+  release(&p->lock);
+
+  p->kfn();
+  panic("kthread returned");
+}
+
+// Start a kernel thread, a process without user memory or
+// files that runs fn(), which must not return. It has no
+// parent, so nothing waits for it.
+void
+kthread(void (*fn)(void), char *name)
+{
+  struct proc *p;
+
+  if((p = allocproc()) == 0)
+    panic("kthread");
+  p->kfn = fn;
+  p->context.ra = (uint64)kthreadstart;
+  safestrcpy(p->name, name, sizeof(p->name));
+  p->state = RUNNABLE;
+  release(&p->lock);
+}
+
 // Grow or shrink user memory by n bytes.
 // Return 0 on success, -1 on failure.
 int
@@ -310,6 +412,8 @@ fork(void)
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
+  np->tracemask = p->tracemask;
+
   pid = np->pid;
 
   release(&np->lock);
@@ -365,6 +469,9 @@ exit(int status)
   end_op();
   p->cwd = 0;
 
+  // Give back any real-time reservation.
+  rtsched(0, 0);
+
   acquire(&wait_lock);
 
   // Give any children to init.
@@ -434,17 +541,234 @@ wait(uint64 addr)
   }
 }
 
+// Utilization of a real-time process, in 1/1000 CPU, rounded up.
+static int
+rtutil(int period, int budget)
+{
+  if(period == 0)
+    return 0;
+  return (budget * 1000 + period - 1) / period;
+}
+
+// Move the current process into the real-time class, reserving
+// budget ticks of CPU time in every period ticks, or back to
+// round-robin if period is 0.  Rejects the request if the
+// total reservation would exceed RTUTILMAX.
+// Returns 0 on success, -1 on error.
+int
+rtsched(int period, int budget)
+{
+  struct proc *p = myproc();
+  int old, new;
+
+  if(period < 0 || budget < 0)
+    return -1;
+  if(period > 0 && (budget == 0 || budget > period))
+    return -1;
+  new = rtutil(period, budget);
+
+  acquire(&rt.lock);
+  acquire(&p->lock);
+  old = rtutil(p->rtperiod, p->rtbudget);
+  if(rt.util - old + new > RTUTILMAX){
+    release(&p->lock);
+    release(&rt.lock);
+    return -1;
+  }
+  rt.util += new - old;
+  if(p->rtperiod == 0 && period > 0){
+    rt.procs[rt.n++] = p;
+  } else if(p->rtperiod > 0 && period == 0){
+    for(int i = 0; i < rt.n; i++){
+      if(rt.procs[i] == p){
+        rt.procs[i] = rt.procs[--rt.n];
+        break;
+      }
+    }
+  }
+  p->rtperiod = period;
+  p->rtbudget = budget;
+  p->rtused = 0;
+  p->rtdeadline = ticks + period;
+  p->rtmissed = 0;
+  release(&p->lock);
+  release(&rt.lock);
+  return 0;
+}
+
+// Charge the running process for the n timer ticks of CPU
+// time that this hart's timer counted, if it is a real-time
+// process.  Called on every hart's timer interrupt, since only
+// hart 0 advances ticks.
+void
+rtcharge(int n)
+{
+  struct proc *p = myproc();
+
+  if(p == 0 || p->rtperiod == 0)
+    return;
+  acquire(&p->lock);
+  if(p->rtperiod)
+    p->rtused += n;
+  release(&p->lock);
+}
+
+// Start a new period for real-time process p if its deadline
+// has passed, replenishing its budget.  A period that ended while
+// p still wanted the CPU but had budget left counts as a miss.
+// Returns 1 if p has budget left in its current period.
+// Caller must hold p->lock.
+static int
+rtreplenish(struct proc *p)
+{
+  int late;
+
+  if((late = ticks - p->rtdeadline) >= 0){
+    if(p->rtused < p->rtbudget &&
+       (p->state == RUNNABLE || p->state == RUNNING))
+      p->rtmissed++;
+    p->rtdeadline += (late / p->rtperiod + 1) * p->rtperiod;
+    p->rtused = 0;
+  }
+  return p->rtused < p->rtbudget;
+}
+
+// Earliest-deadline-first choice among the runnable real-time
+// processes with budget left.  Looks only at rt.procs, not the
+// whole process table.  Returns the process with its lock
+// held, or 0 if there is none.
+static struct proc*
+edfpick(void)
+{
+  struct proc *p, *best = 0;
+  uint deadline = 0;
+  int i;
+
+  // an unlocked peek, so that harts do not all take rt.lock
+  // on every pass when there are no real-time processes.
+  if(__atomic_load_n(&rt.n, __ATOMIC_RELAXED) == 0)
+    return 0;
+
+  acquire(&rt.lock);
+  for(i = 0; i < rt.n; i++){
+    p = rt.procs[i];
+    acquire(&p->lock);
+    if(rtreplenish(p) && p->state == RUNNABLE &&
+       (best == 0 || (int)(p->rtdeadline - deadline) < 0)){
+      best = p;
+      deadline = p->rtdeadline;
+    }
+    release(&p->lock);
+  }
+
+  // best may have been run by another hart since we looked;
+  // rt.lock keeps it in the real-time class.
+  if(best){
+    acquire(&best->lock);
+    if(rtreplenish(best) && best->state == RUNNABLE){
+      release(&rt.lock);
+      return best;
+    }
+    release(&best->lock);
+  }
+  release(&rt.lock);
+  return 0;
+}
+
+// Is a real-time process with budget left waiting to run?
+// Then a round-robin process running should make way for it.
+static int
+rtwaiting(void)
+{
+  struct proc *p;
+  int i, found = 0;
+
+  if(__atomic_load_n(&rt.n, __ATOMIC_RELAXED) == 0)
+    return 0;
+  acquire(&rt.lock);
+  for(i = 0; i < rt.n && !found; i++){
+    p = rt.procs[i];
+    acquire(&p->lock);
+    found = p->state == RUNNABLE && rtreplenish(p);
+    release(&p->lock);
+  }
+  release(&rt.lock);
+  return found;
+}
+
+// Choose a process to run ahead of the round-robin scan:
+// the real-time process with the earliest deadline, or else
+// the process handed this CPU by wakeupsync(), if it has not
+// run elsewhere meanwhile.  Returns it locked, or 0.
+static struct proc*
+pickfirst(struct cpu *c)
+{
+  struct proc *p;
+
+  if((p = edfpick()) != 0)
+    return p;
+
+  if((p = c->handoff) != 0){
+    c->handoff = 0;
+    acquire(&p->lock);
+    if(p->state == RUNNABLE && p->rtperiod == 0)
+      return p;
+    release(&p->lock);
+  }
+  return 0;
+}
+
+// The count of wakeups so far of processes with quanta
+// shorter than q. It changes only when such a process wakes.
+static uint
+wokebelow(int q)
+{
+  uint n = 0;
+  int i;
+
+  for(i = QMIN; i < q; i++)
+    n += __atomic_load_n(&wokegen[i], __ATOMIC_RELAXED);
+  return n;
+}
+
+// Switch to chosen process p, which must be RUNNABLE and
+// locked.  It is the process's job to release its lock and
+// then reacquire it before jumping back to us.
+static void
+run(struct cpu *c, struct proc *p)
+{
+  p->state = RUNNING;
+  p->slice = 0;
+  c->wokeseen = wokebelow(p->quantum);
+  c->proc = p;
+  c->nswitch++;
+  swtch(&c->context, &p->context);
+
+  // Process is done running for now.
+  // It should have changed its p->state before coming back.
+  c->proc = 0;
+
+  // a handoff is for a process that blocks, waiting on the
+  // one it woke; not for one that was preempted or yielded
+  // later, maybe long after the wakeup.
+  if(p->state != SLEEPING)
+    c->handoff = 0;
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
+//  - choose a process to run: the real-time process with
+//    the earliest deadline if there is one, then a process
+//    handed this CPU by wakeupsync(), otherwise the next
+//    round-robin process.
 //  - swtch to start running that process.
 //  - eventually that process transfers control
 //    via swtch back to the scheduler.
 void
 scheduler(void)
 {
-  struct proc *p;
+  struct proc *p, *rp;
   struct cpu *c = mycpu();
   
   c->proc = 0;
@@ -453,19 +777,17 @@ scheduler(void)
     intr_on();
 
     for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
+      // Real-time and handed-off processes skip the queue.
+      while((rp = pickfirst(c)) != 0){
+        run(c, rp);
+        release(&rp->lock);
       }
+
+      // Real-time processes only run within their budget,
+      // never round-robin.
+      acquire(&p->lock);
+      if(p->state == RUNNABLE && p->rtperiod == 0)
+        run(c, p);
       release(&p->lock);
     }
   }
@@ -509,6 +831,42 @@ yield(void)
   release(&p->lock);
 }
 
+// Charge the current process for a clock tick on its CPU.
+// Returns 1 if its time slice has run out, and it should yield().
+// A process that uses its whole slice looks CPU-bound, so its
+// next slice is twice as long, up to QMAX; one that blocks
+// early gets shorter slices again (see blocked()). A slice is
+// cut short after QMIN ticks if a process with a shorter
+// quantum than the running one's has woken up since it began.
+int
+timeslice(void)
+{
+  struct proc *p = myproc();
+
+  // EDF reconsiders deadlines on every tick of a real-time
+  // process; a round-robin one yields only to a real-time
+  // process that is waiting to run.
+  if(p->rtperiod || rtwaiting())
+    return 1;
+  if(++p->slice < p->quantum){
+    if(p->slice < QMIN || mycpu()->wokeseen == wokebelow(p->quantum))
+      return 0;
+  } else if(p->quantum < QMAX)
+    p->quantum *= 2;
+  p->usyscall->nivcsw++;
+  return 1;
+}
+
+// The current process is about to sleep before its time
+// slice ran out: it looks interactive, so halve its quantum.
+static void
+blocked(struct proc *p)
+{
+  if(p->slice < p->quantum && p->quantum > QMIN)
+    p->quantum /= 2;
+  p->usyscall->nvcsw++;
+}
+
 // A fork child's very first scheduling by scheduler()
 // will swtch to forkret.
 void
@@ -548,6 +906,7 @@ sleep(void *chan, struct spinlock *lk)
   release(lk);
 
   // Go to sleep.
+  blocked(p);
   p->chan = chan;
   p->state = SLEEPING;
 
@@ -561,6 +920,155 @@ sleep(void *chan, struct spinlock *lk)
   acquire(lk);
 }
 
+// Like sleep(), but also wake up once time deadline (in time
+// CSR cycles) has passed. Returns 1 if woken by the deadline,
+// 0 if by wakeup() or kill(). The caller rechecks its condition
+// either way, as with sleep().
+int
+sleeptimeout(void *chan, struct spinlock *lk, uint64 deadline)
+{
+  struct proc *p = myproc();
+  int expired;
+
+  // timeradd() before p->lock: timerexpire() acquires
+  // p->lock while holding the timer heap's lock.
+  timeradd(p, deadline);
+
+  acquire(&p->lock);
+  release(lk);
+
+  // the deadline may have passed already, in which case
+  // timerexpire() has found p awake and left p->timedout set.
+  if(!p->timedout){
+    blocked(p);
+    p->chan = chan;
+    p->state = SLEEPING;
+
+    sched();
+
+    p->chan = 0;
+  }
+  release(&p->lock);
+
+  // off the heap, if woken before the deadline. once timerdel()
+  // has the heap lock, no timerexpire() can still be setting
+  // p->timedout, so it is safe to clear.
+  timerdel(p);
+  acquire(&p->lock);
+  expired = p->timedout;
+  p->timedout = 0;
+  release(&p->lock);
+
+  acquire(lk);
+  return expired;
+}
+
+static void
+wqremove(struct waitq *q, struct proc *p)
+{
+  struct proc **pp, *prev = 0;
+
+  for(pp = &q->head; *pp; prev = *pp, pp = &(*pp)->wqnext){
+    if(*pp == p){
+      *pp = p->wqnext;
+      if(q->tail == p)
+        q->tail = prev;
+      break;
+    }
+  }
+  p->wq = 0;
+  p->wqnext = 0;
+}
+
+// Like sleep(), but wait in FIFO order on q, so that
+// wakeupq() can wake just the longest waiters instead
+// of every process. lk must guard q as well as the
+// condition the caller waits for.
+void
+sleepq(struct waitq *q, struct spinlock *lk)
+{
+  sleepqn(q, lk, 1);
+}
+
+// Like sleepq(), for a waiter that needs n units of some
+// resource, for wakeupqn().
+void
+sleepqn(struct waitq *q, struct spinlock *lk, int n)
+{
+  struct proc *p = myproc();
+
+  if(p->wq)
+    panic("sleepq");
+  p->wq = q;
+  p->wqnext = 0;
+  p->wqneed = n;
+  if(q->tail)
+    q->tail->wqnext = p;
+  else
+    q->head = p;
+  q->tail = p;
+
+  sleep(q, lk);
+
+  // still queued if woken by kill() rather than wakeupq().
+  if(p->wq == q)
+    wqremove(q, p);
+}
+
+// Wake the first n processes waiting on q, or all of them
+// if n < 0. The caller holds q's lock, and no p->lock.
+// Returns the number woken.
+int
+wakeupq(struct waitq *q, int n)
+{
+  return wakeupqn(q, n, 0);
+}
+
+// Wake waiters on q in FIFO order: n of them, or all if n < 0;
+// or, if byneed, as many as the n units of a resource
+// available cover, by what each said it needs in sleepqn().
+// Stops at the first waiter that does not fit, so that a
+// waiter needing much is not passed over for ever.
+// The caller holds q's lock, and no p->lock.
+// Returns the number woken.
+int
+wakeupqn(struct waitq *q, int n, int byneed)
+{
+  struct proc *p;
+  int woken = 0;
+
+  while(q->head && (n < 0 || (byneed ? q->head->wqneed <= n : woken < n))){
+    p = q->head;
+    if(byneed)
+      n -= p->wqneed;
+    q->head = p->wqnext;
+    if(q->head == 0)
+      q->tail = 0;
+    p->wq = 0;
+    p->wqnext = 0;
+    // a waiter already made RUNNABLE by kill() doesn't
+    // count; wake the next one in its place.
+    acquire(&p->lock);
+    if(p->state == SLEEPING && p->chan == q){
+      wakeproc(p);
+      woken++;
+    }
+    release(&p->lock);
+  }
+  return woken;
+}
+
+// Make sleeping process p RUNNABLE. If it looks interactive,
+// ask running processes with longer quanta to make way (see
+// timeslice()). Caller must hold p->lock.
+void
+wakeproc(struct proc *p)
+{
+  p->state = RUNNABLE;
+  if(p->quantum < QMAX)
+    __sync_fetch_and_add(&wokegen[p->quantum], 1);
+}
+
 // Wake up all processes sleeping on chan.
 // Must be called without any p->lock.
 void
@@ -572,13 +1080,44 @@ wakeup(void *chan)
     if(p != myproc()){
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
+        wakeproc(p);
       }
       release(&p->lock);
     }
   }
 }
 
+// Like wakeup(), but also hand this CPU to the first process
+// woken: if the caller next gives up the CPU by sleeping, this
+// CPU's scheduler runs that process directly instead of scanning
+// the process table, and before another hart can get to it.
+// For synchronous exchanges, such as a pipe writer waking
+// the reader and then blocking for its reply.
+// Must be called without any p->lock.
+void
+wakeupsync(void *chan)
+{
+  struct proc *p, *me = myproc(), *first = 0;
+
+  for(p = proc; p < &proc[NPROC]; p++) {
+    if(p != me){
+      acquire(&p->lock);
+      if(p->state == SLEEPING && p->chan == chan) {
+        wakeproc(p);
+        if(first == 0)
+          first = p;
+      }
+      release(&p->lock);
+    }
+  }
+
+  if(first){
+    push_off();
+    mycpu()->handoff = first;
+    pop_off();
+  }
+}
+
 // Kill the process with the given pid.
 // The victim won't exit until it tries to return
 // to user space (see usertrap() in trap.c).
@@ -677,7 +1216,9 @@ procdump(void)
       state = states[p->state];
     else
       state = "???";
-    printf("%d %s %s", p->pid, state, p->name);
+    printf("%d %s %s q %d", p->pid, state, p->name, p->quantum);
+    if(p->rtperiod)
+      printf(" rt %d/%d missed %d", p->rtbudget, p->rtperiod, p->rtmissed);
     printf("\n");
   }
 }
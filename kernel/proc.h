@@ -24,6 +24,9 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  struct proc *handoff;       // Run next, if still RUNNABLE; see wakeupsync().
+  uint nswitch;               // Processes run by this CPU's scheduler.
+  uint wokeseen;              // wokebelow() when the running process began.
 };
 
 extern struct cpu cpus[NCPU];
@@ -92,15 +95,46 @@ struct proc {
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
 
+  // real-time (EDF) class; rtperiod == 0 means round-robin.
+  // p->lock must be held when using these, too.
+  int rtperiod;                // Period length, in ticks
+  int rtbudget;                // CPU ticks allowed per period
+  int rtused;                  // CPU ticks consumed this period
+  uint rtdeadline;             // Tick at which this period ends
+  int rtmissed;                // Periods that ended short of budget
+
+  // sampling profiler; see prof.c.
+  // p->lock must be held when using these, too.
+  struct profsample *prof;     // Sample buffer page, or 0
+  int nprof;                   // Samples in the buffer
+  int timedout;                // Woken by sleeptimeout()'s deadline
+
+  // the timer heap's lock must be held when using these; see timer.c.
+  uint64 timeout;              // Deadline, in time CSR cycles
+  int timeridx;                // Index in the timer heap, or 0
+
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
 
+  // the waited-on queue's lock must be held when using these:
+  struct waitq *wq;            // Queue this process waits on, or 0
+  struct proc *wqnext;         // Next waiter on wq
+  int wqneed;                  // What it waits for; see sleepqn()
+
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
+  struct usyscall *usyscall;   // page shared read-only at USYSCALL
+  struct ioring *ioring;       // syscall ring page at IORING, or 0
+  uint64 tracemask;            // syscalls to trace; see trace()
+  int profon;                  // Take samples on timer interrupts
+  int quantum;                 // Time slice length, in clock ticks
+  int slice;                   // Clock ticks used of the current slice
+  int logres;                  // Log blocks reserved by begin_opn()
   struct context context;      // swtch() here to run process
+  void (*kfn)(void);           // Kernel thread's function; see kthread()
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
@@ -0,0 +1,265 @@
+//
+// Sampling profilers for user programs and for the kernel.
+//
+// A process that has called prof(PROF_START) gets a one-page
+// sample buffer. On each timer interrupt from user space,
+// usertrap() calls profuser(), which appends the interrupted
+// pc and a frame-pointer backtrace. Samples stay in the buffer
+// until drained with prof(PROF_READ), even after the process
+// exits, so a parent can collect the last ones before wait().
+//
+// The kernel profiler samples the kernel pc and kernel frame
+// pointers on timer interrupts that arrive in kerneltrap(),
+// into a global buffer read and controlled through the KPROF
+// device. Code that runs with interrupts off (e.g. holding a
+// spinlock) is charged to the point where it turns them on.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "prof.h"
+#include "defs.h"
+
+extern struct proc proc[NPROC];
+extern struct spinlock wait_lock;
+
+// Walk the user stack of p from the trapframe's frame pointer.
+// With -fno-omit-frame-pointer, a function that calls others
+// keeps its return address at fp-8 and the caller's fp at fp-16.
+// A leaf function saves only the caller's fp, at fp-8, and
+// leaves its return address in ra; the walk recognizes that
+// case in the innermost frame by fp-8 pointing into the stack.
+static void
+backtrace(struct proc *p, struct profsample *s)
+{
+  uint64 fp, lo, hi, v[2];
+  int i = 1;
+
+  fp = p->trapframe->s0;
+  lo = PGROUNDDOWN(p->trapframe->sp);
+  hi = lo + PGSIZE;
+  while(i < PROFDEPTH){
+    if(fp % 8 || fp < lo + 16 || fp > hi)
+      break;
+    if(copyin(p->pagetable, (char*)v, fp - 16, sizeof(v)) < 0)
+      break;
+    // v[1] is fp-8, v[0] is fp-16.
+    if(i == 1 && v[1] > fp && v[1] <= hi){
+      s->pc[i++] = p->trapframe->ra;
+      fp = v[1];
+      continue;
+    }
+    if(v[1] == 0)
+      break;
+    s->pc[i++] = v[1];
+    if(v[0] <= fp)
+      break;
+    fp = v[0];
+  }
+  if(i < PROFDEPTH)
+    s->pc[i] = 0;
+}
+
+// Record a sample of the current process, if it is being profiled.
+// Called from usertrap() on timer interrupts.
+void
+profuser(struct proc *p)
+{
+  struct profsample s;
+
+  if(p->prof == 0 || !p->profon)
+    return;
+  s.pc[0] = p->trapframe->epc;
+  backtrace(p, &s);
+  acquire(&p->lock);
+  if(p->nprof < NPROFSAMPLE)
+    p->prof[p->nprof++] = s;
+  release(&p->lock);
+}
+
+// Copy up to n samples of p to addr in the current process
+// and drop them from p's buffer. p->lock must be held.
+static int
+profdrain(struct proc *p, uint64 addr, int n)
+{
+  struct profsample *s = p->prof;
+
+  if(s == 0)
+    return p->state == ZOMBIE ? -1 : 0;
+  if(n > p->nprof)
+    n = p->nprof;
+  if(n == 0)
+    return p->state == ZOMBIE ? -1 : 0;
+  if(copyout(myproc()->pagetable, addr, (char*)s, n*sizeof(*s)) < 0)
+    return -1;
+  memmove(s, s + n, (p->nprof - n)*sizeof(*s));
+  p->nprof -= n;
+  return n;
+}
+
+// prof(cmd, pid, buf, n)
+// PROF_READ returns the number of samples copied to buf, or -1
+// once the profiled process has exited and its buffer is empty.
+uint64
+sys_prof(void)
+{
+  int cmd, pid, n, r;
+  uint64 addr;
+  struct proc *p = myproc();
+  struct proc *pp;
+  char *mem;
+
+  argint(0, &cmd);
+  argint(1, &pid);
+  argaddr(2, &addr);
+  argint(3, &n);
+
+  switch(cmd){
+  case PROF_START:
+    if(p->prof == 0){
+      if((mem = kalloc()) == 0)
+        return -1;
+      acquire(&p->lock);
+      p->prof = (struct profsample*)mem;
+      p->nprof = 0;
+      release(&p->lock);
+    }
+    p->profon = 1;
+    return 0;
+  case PROF_STOP:
+    p->profon = 0;
+    return 0;
+  case PROF_READ:
+    if(n < 0)
+      return -1;
+    if(pid == 0 || pid == p->pid){
+      acquire(&p->lock);
+      r = profdrain(p, addr, n);
+      release(&p->lock);
+      return r;
+    }
+    acquire(&wait_lock);
+    for(pp = proc; pp < &proc[NPROC]; pp++){
+      if(pp->parent != p)
+        continue;
+      acquire(&pp->lock);
+      if(pp->pid == pid){
+        r = profdrain(pp, addr, n);
+        release(&pp->lock);
+        release(&wait_lock);
+        return r;
+      }
+      release(&pp->lock);
+    }
+    release(&wait_lock);
+    return -1;
+  }
+  return -1;
+}
+
+struct {
+  struct spinlock lock;
+  int on;
+  int n;                            // samples in buf
+  struct profsample buf[NKPROF];
+} kprof;
+
+// Record a kernel sample, if the kernel profiler is on.
+// Called from kerneltrap() on timer interrupts, with frame
+// pointing at the registers kernelvec saved: the interrupted
+// ra at frame[0] and s0 at frame[7].
+void
+profkernel(uint64 pc, uint64 *frame)
+{
+  struct profsample s;
+  uint64 fp, lo, hi, *v;
+  int i = 1;
+
+  if(!kprof.on)
+    return;
+
+  // the same walk as backtrace(), on the current kernel stack.
+  s.pc[0] = pc;
+  fp = frame[7];
+  lo = PGROUNDDOWN((uint64)frame);
+  hi = lo + PGSIZE;
+  while(i < PROFDEPTH){
+    if(fp % 8 || fp < lo + 16 || fp > hi)
+      break;
+    v = (uint64*)(fp - 16);
+    if(i == 1 && v[1] > fp && v[1] <= hi){
+      s.pc[i++] = frame[0];
+      fp = v[1];
+      continue;
+    }
+    if(v[1] == 0)
+      break;
+    s.pc[i++] = v[1];
+    if(v[0] <= fp)
+      break;
+    fp = v[0];
+  }
+  if(i < PROFDEPTH)
+    s.pc[i] = 0;
+
+  acquire(&kprof.lock);
+  if(kprof.on && kprof.n < NKPROF)
+    kprof.buf[kprof.n++] = s;
+  release(&kprof.lock);
+}
+
+// Read whole samples from the kernel profiler and
+// drop them from its buffer.
+static int
+kprofread(int user_dst, uint64 dst, int n)
+{
+  int m;
+
+  acquire(&kprof.lock);
+  m = n / sizeof(struct profsample);
+  if(m > kprof.n)
+    m = kprof.n;
+  if(either_copyout(user_dst, dst, kprof.buf, m * sizeof(struct profsample)) < 0){
+    release(&kprof.lock);
+    return -1;
+  }
+  memmove(kprof.buf, kprof.buf + m, (kprof.n - m) * sizeof(struct profsample));
+  kprof.n -= m;
+  release(&kprof.lock);
+  return m * sizeof(struct profsample);
+}
+
+// Writing '1' empties the buffer and starts sampling;
+// writing '0' stops it.
+static int
+kprofwrite(int user_src, uint64 src, int n)
+{
+  char c;
+
+  if(n < 1 || either_copyin(&c, user_src, src, 1) < 0)
+    return -1;
+  acquire(&kprof.lock);
+  if(c == '1'){
+    kprof.n = 0;
+    kprof.on = 1;
+  } else if(c == '0'){
+    kprof.on = 0;
+  }
+  release(&kprof.lock);
+  return n;
+}
+
+void
+kprofinit(void)
+{
+  initlock(&kprof.lock, "kprof");
+  devsw[KPROF].read = kprofread;
+  devsw[KPROF].write = kprofwrite;
+}
@@ -0,0 +1,18 @@
+// Sampling profiler.
+// Both the kernel and user programs use this header file.
+
+#define PROFDEPTH 8    // pcs per sample
+
+// prof() commands
+#define PROF_START 1   // start sampling the calling process
+#define PROF_STOP  2   // stop sampling the calling process
+#define PROF_READ  3   // drain samples of a child (or self if pid is 0)
+
+// one sample: pc[0] is the interrupted pc, pc[1..] the return
+// addresses found by walking frame pointers, 0-terminated if
+// the walk ended early.
+struct profsample {
+  uint64 pc[PROFDEPTH];
+};
+
+#define NPROFSAMPLE (PGSIZE / sizeof(struct profsample))
@@ -40,6 +40,14 @@ w_mepc(uint64 x)
   asm volatile("csrw mepc, %0" : : "r" (x));
 }
 
+static inline uint64
+r_mepc()
+{
+  uint64 x;
+  asm volatile("csrr %0, mepc" : "=r" (x) );
+  return x;
+}
+
 // Supervisor Status Register, sstatus
 
 #define SSTATUS_SPP (1L << 8)  // Previous mode, 1=Supervisor, 0=User
@@ -177,6 +185,14 @@ r_stvec()
 }
 
 // Machine-mode interrupt vector
+static inline uint64
+r_mtvec()
+{
+  uint64 x;
+  asm volatile("csrr %0, mtvec" : "=r" (x) );
+  return x;
+}
+
 static inline void 
 w_mtvec(uint64 x)
 {
@@ -256,6 +272,49 @@ r_mcounteren()
   return x;
 }
 
+// Supervisor-mode Counter-Enable
+static inline void 
+w_scounteren(uint64 x)
+{
+  asm volatile("csrw scounteren, %0" : : "r" (x));
+}
+
+static inline uint64
+r_scounteren()
+{
+  uint64 x;
+  asm volatile("csrr %0, scounteren" : "=r" (x) );
+  return x;
+}
+
+// counteren bit that lets a lower mode read the time CSR.
+#define COUNTEREN_TM (1L << 1)
+
+// Machine Environment Configuration, and Supervisor Timer
+// Compare from the Sstc extension. numeric CSR addresses,
+// since older assemblers do not know these names.
+#define MENVCFG_STCE (1L << 63) // enable stimecmp
+
+static inline void 
+w_menvcfg(uint64 x)
+{
+  asm volatile("csrw 0x30a, %0" : : "r" (x));
+}
+
+static inline void 
+w_stimecmp(uint64 x)
+{
+  asm volatile("csrw 0x14d, %0" : : "r" (x));
+}
+
+static inline uint64
+r_stimecmp()
+{
+  uint64 x;
+  asm volatile("csrr %0, 0x14d" : "=r" (x) );
+  return x;
+}
+
 // machine-mode cycle counter
 static inline uint64
 r_time()
@@ -319,6 +378,15 @@ r_ra()
   return x;
 }
 
+// read s0, the frame pointer.
+static inline uint64
+r_fp()
+{
+  uint64 x;
+  asm volatile("mv %0, s0" : "=r" (x) );
+  return x;
+}
+
 // flush the TLB.
 static inline void
 sfence_vma()
@@ -0,0 +1,129 @@
+// Reader-writer spin locks and sequence locks.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "rwlock.h"
+#include "seqlock.h"
+#include "riscv.h"
+#include "proc.h"
+#include "defs.h"
+
+void
+initrwlock(struct rwlock *rw, char *name)
+{
+  rw->name = name;
+  rw->cnt = 0;
+  rw->wwait = 0;
+  rw->cpu = 0;
+}
+
+// Acquire rw for reading: wait while a writer holds it or
+// waits for it, so a stream of readers cannot starve writers.
+void
+acquireread(struct rwlock *rw)
+{
+  int c;
+
+  push_off(); // disable interrupts to avoid deadlock.
+  if(holdingwrite(rw))
+    panic("acquireread");
+  for(;;){
+    c = __atomic_load_n(&rw->cnt, __ATOMIC_RELAXED);
+    if(c >= 0 && __atomic_load_n(&rw->wwait, __ATOMIC_RELAXED) == 0 &&
+       __sync_bool_compare_and_swap(&rw->cnt, c, c + 1))
+      break;
+  }
+  __sync_synchronize();
+}
+
+void
+releaseread(struct rwlock *rw)
+{
+  __sync_synchronize();
+  if(__sync_fetch_and_sub(&rw->cnt, 1) <= 0)
+    panic("releaseread");
+  pop_off();
+}
+
+// Acquire rw for writing, once all readers have left.
+void
+acquirewrite(struct rwlock *rw)
+{
+  push_off();
+  if(holdingwrite(rw))
+    panic("acquirewrite");
+  __sync_fetch_and_add(&rw->wwait, 1);
+  while(!__sync_bool_compare_and_swap(&rw->cnt, 0, -1))
+    ;
+  __sync_fetch_and_sub(&rw->wwait, 1);
+  __sync_synchronize();
+  rw->cpu = mycpu();
+}
+
+void
+releasewrite(struct rwlock *rw)
+{
+  if(!holdingwrite(rw))
+    panic("releasewrite");
+  rw->cpu = 0;
+  __sync_synchronize();
+  __atomic_store_n(&rw->cnt, 0, __ATOMIC_RELEASE);
+  pop_off();
+}
+
+// Check whether this cpu holds rw for writing.
+// Interrupts must be off.
+int
+holdingwrite(struct rwlock *rw)
+{
+  return rw->cnt == -1 && rw->cpu == mycpu();
+}
+
+void
+initseqlock(struct seqlock *sl, char *name)
+{
+  initlock(&sl->lk, name);
+  sl->seq = 0;
+}
+
+// Begin an update; seq becomes odd.
+void
+acquireseq(struct seqlock *sl)
+{
+  acquire(&sl->lk);
+  sl->seq++;
+  __sync_synchronize();
+}
+
+// End an update; seq becomes even again.
+void
+releaseseq(struct seqlock *sl)
+{
+  __sync_synchronize();
+  sl->seq++;
+  release(&sl->lk);
+}
+
+// Begin a read: returns the sequence number to
+// pass to readseqretry() after reading.
+uint
+readseqbegin(struct seqlock *sl)
+{
+  uint s;
+
+  while((s = __atomic_load_n(&sl->seq, __ATOMIC_RELAXED)) & 1)
+    ;
+  __sync_synchronize();
+  return s;
+}
+
+// Returns 1 if a writer may have changed the data since
+// readseqbegin() returned s, and the read must be redone.
+int
+readseqretry(struct seqlock *sl, uint s)
+{
+  __sync_synchronize();
+  return __atomic_load_n(&sl->seq, __ATOMIC_RELAXED) != s;
+}
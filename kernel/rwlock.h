@@ -0,0 +1,13 @@
+// Reader-writer spin lock, for read-mostly data.
+// Any number of readers, or one writer, may hold it.
+// Like a spinlock, it is held with interrupts off and
+// must not be held across sleep() or sched().
+struct rwlock {
+  int cnt;           // Readers holding it, or -1 if a writer does
+  uint wwait;        // Writers waiting; new readers hold back
+
+  // For debugging:
+  char *name;        // Name of lock.
+  struct cpu *cpu;   // The cpu holding it for writing.
+};
+
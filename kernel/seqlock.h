@@ -0,0 +1,9 @@
+// Sequence lock, for small data that is read often and
+// written rarely. Writers serialize on lk and make seq odd
+// while they update; readers take no lock and retry if seq
+// was odd or changed while they read.
+struct seqlock {
+  uint seq;
+  struct spinlock lk;
+};
+
@@ -9,6 +9,14 @@
 #include "proc.h"
 #include "sleeplock.h"
 
+// how contended acquiresleep() calls ended up; see statssleep().
+static struct {
+  uint64 contended;   // found the lock held
+  uint64 spinwon;     // spun, and got it without sleeping
+  uint64 spinlost;    // spun, then slept anyway
+  uint64 slept;       // slept without spinning: holder not running
+} sstats;
+
 void
 initsleeplock(struct sleeplock *lk, char *name)
 {
@@ -16,17 +24,60 @@ initsleeplock(struct sleeplock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->pid = 0;
+  lk->owner = 0;
+  lk->wq.head = lk->wq.tail = 0;
+}
+
+// Spin, with lk->lk released, while lk is held by a process that
+// is running on another CPU: it will likely release lk before a
+// sleep() and wakeup() round trip would complete. Gives up after
+// SLEEPSPIN cycles, or as soon as the holder stops running.
+// Returns 1 if lk was seen free.
+static int
+spinsleep(struct sleeplock *lk)
+{
+  struct proc *owner;
+  uint64 end = r_time() + SLEEPSPIN;
+
+  release(&lk->lk);
+  // the reads of owner and its state are unlocked hints; a proc
+  // structure is never freed, so following the pointer is safe.
+  while(__atomic_load_n(&lk->locked, __ATOMIC_RELAXED)){
+    owner = __atomic_load_n(&lk->owner, __ATOMIC_RELAXED);
+    if(owner == 0 || owner->state != RUNNING || r_time() >= end)
+      break;
+  }
+  acquire(&lk->lk);
+  return !lk->locked;
 }
 
 void
 acquiresleep(struct sleeplock *lk)
 {
+  int spun = 0;
+
   acquire(&lk->lk);
+  if(lk->locked)
+    __sync_fetch_and_add(&sstats.contended, 1);
   while (lk->locked) {
-    sleep(lk, &lk->lk);
+    if(!spun && lk->owner && lk->owner->state == RUNNING){
+      spun = 1;
+      if(spinsleep(lk)){
+        __sync_fetch_and_add(&sstats.spinwon, 1);
+        break;
+      }
+      __sync_fetch_and_add(&sstats.spinlost, 1);
+      continue;
+    }
+    if(!spun){
+      spun = 1;
+      __sync_fetch_and_add(&sstats.slept, 1);
+    }
+    sleepq(&lk->wq, &lk->lk);
   }
   lk->locked = 1;
   lk->pid = myproc()->pid;
+  lk->owner = myproc();
   release(&lk->lk);
 }
 
@@ -36,7 +87,10 @@ releasesleep(struct sleeplock *lk)
   acquire(&lk->lk);
   lk->locked = 0;
   lk->pid = 0;
-  wakeup(lk);
+  lk->owner = 0;
+  // one waiter can take the lock; waking the rest would
+  // just send them back to sleep.
+  wakeupq(&lk->wq, 1);
   release(&lk->lk);
 }
 
@@ -51,5 +105,18 @@ holdingsleep(struct sleeplock *lk)
   return r;
 }
 
+// Format the adaptive spinning counters into buf.
+// Called by the statistics device; see stats.c.
+int
+statssleep(char *buf, int sz)
+{
+  return snprintf(buf, sz, "sleeplocks: %l contended, %l won by spinning, "
+                  "%l spun then slept, %l slept at once\n",
+                  sstats.contended, sstats.spinwon, sstats.spinlost, sstats.slept);
+}
 
-
+void
+statssleepreset(void)
+{
+  memset(&sstats, 0, sizeof(sstats));
+}
@@ -1,10 +1,19 @@
+// FIFO queue of processes waiting for a condition guarded by
+// a spinlock; see sleepq() and wakeupq() in proc.c.
+struct waitq {
+  struct proc *head;
+  struct proc *tail;
+};
+
 // Long-term locks for processes
 struct sleeplock {
   uint locked;       // Is the lock held?
   struct spinlock lk; // spinlock protecting this sleep lock
+  struct waitq wq;   // processes waiting for the lock
   
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+  struct proc *owner; // Process holding lock, for adaptive spinning
 };
 
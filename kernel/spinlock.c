@@ -8,12 +8,52 @@
 #include "proc.h"
 #include "defs.h"
 
+// every initialized lock, for statslock().
+#define NLOCK (NBUFMAX+640)
+static struct spinlock *locks[NLOCK];
+static struct spinlock lock_locks = { .name = "lock_locks" };
+
 void
 initlock(struct spinlock *lk, char *name)
 {
+  int i;
+
   lk->name = name;
+#ifdef TICKETLOCK
+  lk->next = 0;
+  lk->owner = 0;
+#else
   lk->locked = 0;
+#endif
   lk->cpu = 0;
+  lk->nacquire = 0;
+  lk->nspin = 0;
+  lk->nhold = 0;
+
+  acquire(&lock_locks);
+  for(i = 0; i < NLOCK; i++){
+    if(locks[i] == 0){
+      locks[i] = lk;
+      break;
+    }
+  }
+  release(&lock_locks);
+}
+
+// Forget a lock that is about to be freed.
+void
+freelock(struct spinlock *lk)
+{
+  int i;
+
+  acquire(&lock_locks);
+  for(i = 0; i < NLOCK; i++){
+    if(locks[i] == lk){
+      locks[i] = 0;
+      break;
+    }
+  }
+  release(&lock_locks);
 }
 
 // Acquire the lock.
@@ -21,16 +61,27 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  uint64 spins = 0;
+
   push_off(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
+#ifdef TICKETLOCK
+  // Take a ticket with an atomic add (amoadd.w), then wait for
+  // it to be called. Waiters only read owner, so they spin in
+  // their own caches until the holder's store to owner.
+  uint ticket = __sync_fetch_and_add(&lk->next, 1);
+  while(__atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE) != ticket)
+    spins++;
+#else
   // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
   //   a5 = 1
   //   s1 = &lk->locked
   //   amoswap.w.aq a5, a5, (s1)
   while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+    spins++;
+#endif
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,6 +91,11 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for holding() and debugging.
   lk->cpu = mycpu();
+
+  // we hold the lock, so plain updates are safe.
+  lk->nacquire++;
+  lk->nspin += spins;
+  lk->t0 = r_time();
 }
 
 // Release the lock.
@@ -49,6 +105,7 @@ release(struct spinlock *lk)
   if(!holding(lk))
     panic("release");
 
+  lk->nhold += r_time() - lk->t0;
   lk->cpu = 0;
 
   // Tell the C compiler and the CPU to not move loads or stores
@@ -59,6 +116,10 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
+#ifdef TICKETLOCK
+  // Call the next ticket. Only the holder writes owner.
+  __atomic_store_n(&lk->owner, lk->owner + 1, __ATOMIC_RELEASE);
+#else
   // Release the lock, equivalent to lk->locked = 0.
   // This code doesn't use a C assignment, since the C standard
   // implies that an assignment might be implemented with
@@ -67,6 +128,7 @@ release(struct spinlock *lk)
   //   s1 = &lk->locked
   //   amoswap.w zero, zero, (s1)
   __sync_lock_release(&lk->locked);
+#endif
 
   pop_off();
 }
@@ -77,7 +139,24 @@ int
 holding(struct spinlock *lk)
 {
   int r;
+#ifdef TICKETLOCK
+  r = (lk->owner != lk->next && lk->cpu == mycpu());
+#else
   r = (lk->locked && lk->cpu == mycpu());
+#endif
+  return r;
+}
+
+// Check whether this cpu holds any spin lock (or has
+// otherwise pushed interrupts off).
+int
+holdingany(void)
+{
+  int r;
+
+  push_off();
+  r = mycpu()->noff > 1;
+  pop_off();
   return r;
 }
 
@@ -108,3 +187,82 @@ pop_off(void)
   if(c->noff == 0 && c->intena)
     intr_on();
 }
+
+// Format statistics for the locks with the most spinning into
+// buf, one line per lock name (locks that share a name, such as
+// the "proc" locks, are added together). Returns the length.
+// Called by the statistics device; see stats.c.
+#define NNAME 64
+#define NTOP  10
+static struct lockstat {
+  char *name;
+  uint64 nacquire, nspin, nhold;
+} byname[NNAME];
+
+int
+statslock(char *buf, int sz)
+{
+  struct spinlock *lk;
+  struct lockstat t;
+  uint64 nacquire = 0, nspin = 0;
+  int i, j, k, n, nname = 0;
+
+  acquire(&lock_locks);
+  for(i = 0; i < NLOCK; i++){
+    if((lk = locks[i]) == 0)
+      continue;
+    nacquire += lk->nacquire;
+    nspin += lk->nspin;
+    for(j = 0; j < nname; j++)
+      if(strncmp(byname[j].name, lk->name, 32) == 0)
+        break;
+    if(j == nname){
+      if(nname == NNAME)
+        continue;
+      byname[j].name = lk->name;
+      byname[j].nacquire = byname[j].nspin = byname[j].nhold = 0;
+      nname++;
+    }
+    byname[j].nacquire += lk->nacquire;
+    byname[j].nspin += lk->nspin;
+    byname[j].nhold += lk->nhold;
+  }
+
+  // most spins first, then most acquires.
+  for(i = 1; i < nname; i++){
+    for(k = i; k > 0; k--){
+      if(byname[k].nspin < byname[k-1].nspin ||
+         (byname[k].nspin == byname[k-1].nspin && byname[k].nacquire <= byname[k-1].nacquire))
+        break;
+      t = byname[k];
+      byname[k] = byname[k-1];
+      byname[k-1] = t;
+    }
+  }
+
+  n = snprintf(buf, sz, "%-12s %10s %10s %14s\n", "lock", "acquires", "spins", "hold cycles");
+  for(i = 0; i < nname && i < NTOP && byname[i].nacquire; i++)
+    n += snprintf(buf+n, sz-n, "%-12s %10l %10l %14l\n", byname[i].name,
+                  byname[i].nacquire, byname[i].nspin, byname[i].nhold);
+  release(&lock_locks);
+  n += snprintf(buf+n, sz-n, "%-12s %10l %10l\n", "total", nacquire, nspin);
+  return n;
+}
+
+// Zero every lock's statistics. A holder's update may race
+// with this and survive, which is harmless for statistics.
+void
+statsreset(void)
+{
+  int i;
+
+  acquire(&lock_locks);
+  for(i = 0; i < NLOCK; i++){
+    if(locks[i]){
+      locks[i]->nacquire = 0;
+      locks[i]->nspin = 0;
+      locks[i]->nhold = 0;
+    }
+  }
+  release(&lock_locks);
+}
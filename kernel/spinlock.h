@@ -1,9 +1,24 @@
 // Mutual exclusion lock.
+// Build with TICKETLOCK=1 for FIFO ticket locks, which hand the
+// lock to waiting CPUs in arrival order instead of letting them
+// race with atomic swaps on one word. The default stays the
+// test-and-set lock; use lockbench to compare the two.
 struct spinlock {
+#ifdef TICKETLOCK
+  uint next;         // Next ticket to hand out
+  uint owner;        // Ticket now allowed to hold the lock
+#else
   uint locked;       // Is the lock held?
+#endif
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+
+  // Statistics, updated only by the holder; see statslock().
+  uint64 nacquire;   // Times acquired
+  uint64 nspin;      // Spin iterations waiting for it
+  uint64 nhold;      // Time CSR cycles it was held
+  uint64 t0;         // When the current holder acquired it
 };
 
@@ -0,0 +1,135 @@
+//
+// formatted output to a buffer -- snprintf.
+//
+
+#include <stdarg.h>
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "riscv.h"
+#include "defs.h"
+
+static char digits[] = "0123456789abcdef";
+
+// the output buffer, and how much of it is used.
+struct out {
+  char *buf;
+  int sz;
+  int n;
+};
+
+static void
+putc(struct out *o, char c)
+{
+  // always leave room for the terminating 0.
+  if(o->n < o->sz - 1)
+    o->buf[o->n++] = c;
+}
+
+// format x, padded with spaces to width (left-justified if left).
+static void
+putint(struct out *o, uint64 x, int base, int sign, int width, int left)
+{
+  char buf[24];
+  int i = 0, neg = 0;
+
+  if(sign && (long)x < 0){
+    neg = 1;
+    x = -x;
+  }
+  do {
+    buf[i++] = digits[x % base];
+  } while((x /= base) != 0);
+  if(neg)
+    buf[i++] = '-';
+  for(width -= i; !left && width > 0; width--)
+    putc(o, ' ');
+  while(--i >= 0)
+    putc(o, buf[i]);
+  for(; width > 0; width--)
+    putc(o, ' ');
+}
+
+static void
+putstr(struct out *o, char *s, int width, int left)
+{
+  if(s == 0)
+    s = "(null)";
+  for(width -= strlen(s); !left && width > 0; width--)
+    putc(o, ' ');
+  for(; *s; s++)
+    putc(o, *s);
+  for(; width > 0; width--)
+    putc(o, ' ');
+}
+
+// Format into buf, which holds sz bytes, and 0-terminate it.
+// Understands %d, %l (64-bit), %x, %p and %s, with an optional
+// width and '-' for left-justification. Returns the number of
+// characters stored, not counting the 0; output that does not
+// fit is dropped.
+int
+snprintf(char *buf, int sz, char *fmt, ...)
+{
+  va_list ap;
+  struct out o;
+  int i, c, width, left;
+
+  if(sz <= 0)
+    return 0;
+  o.buf = buf;
+  o.sz = sz;
+  o.n = 0;
+
+  va_start(ap, fmt);
+  for(i = 0; (c = fmt[i] & 0xff) != 0; i++){
+    if(c != '%'){
+      putc(&o, c);
+      continue;
+    }
+    left = 0;
+    width = 0;
+    if(fmt[i+1] == '-'){
+      left = 1;
+      i++;
+    }
+    while(fmt[i+1] >= '0' && fmt[i+1] <= '9')
+      width = width*10 + fmt[++i] - '0';
+    c = fmt[++i] & 0xff;
+    if(c == 0)
+      break;
+    switch(c){
+    case 'd':
+      putint(&o, va_arg(ap, int), 10, 1, width, left);
+      break;
+    case 'l':
+      putint(&o, va_arg(ap, uint64), 10, 0, width, left);
+      break;
+    case 'x':
+      putint(&o, va_arg(ap, uint), 16, 0, width, left);
+      break;
+    case 'p':
+      putstr(&o, "0x", 0, 0);
+      putint(&o, va_arg(ap, uint64), 16, 0, width, left);
+      break;
+    case 's':
+      putstr(&o, va_arg(ap, char*), width, left);
+      break;
+    case '%':
+      putc(&o, '%');
+      break;
+    default:
+      // Print unknown % sequence to draw attention.
+      putc(&o, '%');
+      putc(&o, c);
+      break;
+    }
+  }
+  va_end(ap);
+  o.buf[o.n] = 0;
+  return o.n;
+}
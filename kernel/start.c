@@ -6,16 +6,24 @@
 
 void main();
 void timerinit();
+int sstcprobe();
 
 // entry.S needs one stack per CPU.
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
 // a scratch area per CPU for machine-mode timer interrupts.
-uint64 timer_scratch[NCPU][5];
+uint64 timer_scratch[NCPU][8];
+
+// set if the harts have the Sstc extension, in which case
+// supervisor mode takes timer interrupts from stimecmp itself.
+int sstc;
 
 // assembly code in kernelvec.S for machine-mode timer interrupt.
 extern void timervec();
 
+// assembly code in kernelvec.S that skips an illegal instruction.
+extern void probevec();
+
 // entry.S jumps here in machine mode on stack0.
 void
 start()
@@ -43,8 +51,18 @@ start()
   w_pmpaddr0(0x3fffffffffffffull);
   w_pmpcfg0(0xf);
 
-  // ask for clock interrupts.
-  timerinit();
+  // let supervisor and user mode read the time CSR,
+  // for r_time() and user space's rdtime().
+  w_mcounteren(r_mcounteren() | COUNTEREN_TM);
+  w_scounteren(r_scounteren() | COUNTEREN_TM);
+
+  // ask for clock interrupts: from stimecmp, programmed by
+  // timerinithart() in supervisor mode, if this hart has Sstc;
+  // otherwise from the CLINT by way of timervec.
+  if(sstcprobe())
+    sstc = 1;
+  else
+    timerinit();
 
   // keep each CPU's hartid in its tp register, for cpuid().
   int id = r_mhartid();
@@ -54,6 +72,30 @@ start()
   asm volatile("mret");
 }
 
+// does this hart have the Sstc extension? try to turn on
+// menvcfg.STCE and see if it sticks. a hart that predates
+// menvcfg traps on the access; probevec skips the instruction
+// and x stays 0. the trap, and probevec's mret, change mepc
+// and mstatus.MPP, which start() has already set up for its
+// own mret, so they go back to what they were, as does mtvec,
+// so that a later machine-mode trap is not silently skipped.
+// probevec uses only t0, which the asm says it clobbers.
+int
+sstcprobe()
+{
+  uint64 x = 0, vec, status, epc;
+
+  vec = r_mtvec();
+  status = r_mstatus();
+  epc = r_mepc();
+  w_mtvec((uint64)probevec);
+  asm volatile("csrs 0x30a, %1\n\tcsrr %0, 0x30a" : "+r" (x) : "r" (MENVCFG_STCE) : "t0");
+  w_mtvec(vec);
+  w_mstatus(status);
+  w_mepc(epc);
+  return (x & MENVCFG_STCE) != 0;
+}
+
 // arrange to receive timer interrupts.
 // they will arrive in machine mode at
 // at timervec in kernelvec.S,
@@ -66,16 +108,23 @@ timerinit()
   int id = r_mhartid();
 
   // ask the CLINT for a timer interrupt.
-  int interval = 1000000; // cycles; about 1/10th second in qemu.
-  *(uint64*)CLINT_MTIMECMP(id) = *(uint64*)CLINT_MTIME + interval;
+  int interval = TICKINTERVAL;
+  uint64 next = *(uint64*)CLINT_MTIME + interval;
+  *(uint64*)CLINT_MTIMECMP(id) = next;
 
   // prepare information in scratch[] for timervec.
   // scratch[0..2] : space for timervec to save registers.
   // scratch[3] : address of CLINT MTIMECMP register.
   // scratch[4] : desired interval (in cycles) between timer interrupts.
+  // scratch[5] : time of the next periodic interrupt.
+  // scratch[6] : one-shot deadline set by timerset(), or 0.
+  // scratch[7] : periodic interrupts not yet seen by timerintr().
   uint64 *scratch = &timer_scratch[id][0];
   scratch[3] = CLINT_MTIMECMP(id);
   scratch[4] = interval;
+  scratch[5] = next;
+  scratch[6] = 0;
+  scratch[7] = 0;
   w_mscratch((uint64)scratch);
 
   // set the machine-mode trap handler.
@@ -0,0 +1,72 @@
+//
+// the statistics device: reading it returns a text report
+// of lock and buffer cache statistics (see statslock() in
+// spinlock.c, statssleep() in sleeplock.c and statsbcache()
+// in bio.c); writing anything to it zeroes them.
+//
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "riscv.h"
+#include "defs.h"
+
+#define BUFSZ 4096
+
+static struct {
+  struct spinlock lock;
+  char buf[BUFSZ];
+  int sz;       // length of the report in buf, or 0
+  int off;      // how much of it has been read
+} stats;
+
+static int
+statswrite(int user_src, uint64 src, int n)
+{
+  statsreset();
+  statssleepreset();
+  statsbcachereset();
+  return n;
+}
+
+// the first read takes a snapshot; reads continue through it
+// and then return 0 once, after which the next read starts
+// a new snapshot.
+static int
+statsread(int user_dst, uint64 dst, int n)
+{
+  int m;
+
+  acquire(&stats.lock);
+  if(stats.sz == 0){
+    stats.sz = statslock(stats.buf, BUFSZ);
+    stats.sz += statssleep(stats.buf + stats.sz, BUFSZ - stats.sz);
+    stats.sz += statsbcache(stats.buf + stats.sz, BUFSZ - stats.sz);
+  }
+  m = stats.sz - stats.off;
+  if(m > 0){
+    if(m > n)
+      m = n;
+    if(either_copyout(user_dst, dst, stats.buf + stats.off, m) < 0)
+      m = -1;
+    else
+      stats.off += m;
+  } else {
+    m = 0;
+    stats.sz = 0;
+    stats.off = 0;
+  }
+  release(&stats.lock);
+  return m;
+}
+
+void
+statsinit(void)
+{
+  initlock(&stats.lock, "stats");
+  devsw[STATS].read = statsread;
+  devsw[STATS].write = statswrite;
+}
@@ -101,6 +101,16 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_link(void);
 extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
+extern uint64 sys_rtsched(void);
+extern uint64 sys_ringsetup(void);
+extern uint64 sys_ringenter(void);
+extern uint64 sys_trace(void);
+extern uint64 sys_traceread(void);
+extern uint64 sys_syshist(void);
+extern uint64 sys_prof(void);
+extern uint64 sys_clock_gettime(void);
+extern uint64 sys_nanosleep(void);
+extern uint64 sys_fsync(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -126,19 +136,40 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_rtsched] sys_rtsched,
+[SYS_ringsetup] sys_ringsetup,
+[SYS_ringenter] sys_ringenter,
+[SYS_trace]   sys_trace,
+[SYS_traceread] sys_traceread,
+[SYS_syshist] sys_syshist,
+[SYS_prof]    sys_prof,
+[SYS_clock_gettime] sys_clock_gettime,
+[SYS_nanosleep] sys_nanosleep,
+[SYS_fsync]   sys_fsync,
 };
 
 void
 syscall(void)
 {
   int num;
+  uint64 args[3], t0, t;
   struct proc *p = myproc();
 
   num = p->trapframe->a7;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
     // Use num to lookup the system call function for num, call it,
-    // and store its return value in p->trapframe->a0
+    // and store its return value in p->trapframe->a0.
+    // save the arguments for tracing first: a handler such
+    // as exec's may overwrite the trapframe.
+    args[0] = p->trapframe->a0;
+    args[1] = p->trapframe->a1;
+    args[2] = p->trapframe->a2;
+    t0 = r_time();
     p->trapframe->a0 = syscalls[num]();
+    t = r_time() - t0;
+    syscall_hist(num, t);
+    if(p->tracemask & (1L << num))
+      syscall_trace(p, num, args, p->trapframe->a0, t);
   } else {
     printf("%d %s: unknown sys call %d\n",
             p->pid, p->name, num);
@@ -20,3 +20,13 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_rtsched 22
+#define SYS_ringsetup 23
+#define SYS_ringenter 24
+#define SYS_trace  25
+#define SYS_traceread 26
+#define SYS_syshist 27
+#define SYS_prof   28
+#define SYS_clock_gettime 29
+#define SYS_nanosleep 30
+#define SYS_fsync  31
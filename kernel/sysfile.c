@@ -15,6 +15,8 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "memlayout.h"
+#include "ioring.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -94,16 +96,39 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
+// Close file descriptor fd of the current process.
+static int
+fdclose(int fd)
+{
+  struct file *f;
+  struct proc *p = myproc();
+
+  if(fd < 0 || fd >= NOFILE || (f=p->ofile[fd]) == 0)
+    return -1;
+  p->ofile[fd] = 0;
+  fileclose(f);
+  return 0;
+}
+
 uint64
 sys_close(void)
 {
   int fd;
+
+  argint(0, &fd);
+  return fdclose(fd);
+}
+
+// Return once everything written so far is on disk. The log
+// commits all files at once, so fd only has to be open.
+uint64
+sys_fsync(void)
+{
   struct file *f;
 
-  if(argfd(0, &fd, &f) < 0)
+  if(argfd(0, 0, &f) < 0)
     return -1;
-  myproc()->ofile[fd] = 0;
-  fileclose(f);
+  logsync();
   return 0;
 }
 
@@ -301,18 +326,14 @@ create(char *path, short type, short major, short minor)
   return 0;
 }
 
-uint64
-sys_open(void)
+// Open path with mode omode and return a new file descriptor
+// for it, or -1.
+static int
+openpath(char *path, int omode)
 {
-  char path[MAXPATH];
-  int fd, omode;
+  int fd;
   struct file *f;
   struct inode *ip;
-  int n;
-
-  argint(1, &omode);
-  if((n = argstr(0, path, MAXPATH)) < 0)
-    return -1;
 
   begin_op();
 
@@ -355,6 +376,9 @@ sys_open(void)
   } else {
     f->type = FD_INODE;
     f->off = 0;
+    f->raoff = 0;
+    f->rawin = 0;
+    f->ranext = 0;
   }
   f->ip = ip;
   f->readable = !(omode & O_WRONLY);
@@ -370,6 +394,18 @@ sys_open(void)
   return fd;
 }
 
+uint64
+sys_open(void)
+{
+  char path[MAXPATH];
+  int omode;
+
+  argint(1, &omode);
+  if(argstr(0, path, MAXPATH) < 0)
+    return -1;
+  return openpath(path, omode);
+}
+
 uint64
 sys_mkdir(void)
 {
@@ -503,3 +539,93 @@ sys_pipe(void)
   }
   return 0;
 }
+
+// Map a submission/completion ring page at IORING in the
+// calling process, shared with the kernel, and return its
+// user address.  See kernel/ioring.h.
+uint64
+sys_ringsetup(void)
+{
+  struct proc *p = myproc();
+  char *mem;
+
+  if(p->ioring)
+    return IORING;
+  if((mem = kalloc()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  if(mappages(p->pagetable, IORING, PGSIZE, (uint64)mem,
+              PTE_R | PTE_W | PTE_U) < 0){
+    kfree(mem);
+    return -1;
+  }
+  p->ioring = (struct ioring*)mem;
+  return IORING;
+}
+
+// Carry out one submitted operation on behalf of the
+// current process.  Returns what the system call would.
+static int
+ioring_op(struct iosqe *sqe)
+{
+  struct file *f = 0;
+  char path[MAXPATH];
+
+  if(sqe->op == IORING_OP_OPEN){
+    if(fetchstr(sqe->addr, path, MAXPATH) < 0)
+      return -1;
+    return openpath(path, sqe->flags);
+  }
+  if(sqe->op == IORING_OP_CLOSE)
+    return fdclose(sqe->fd);
+
+  if(sqe->fd < 0 || sqe->fd >= NOFILE || (f=myproc()->ofile[sqe->fd]) == 0)
+    return -1;
+  switch(sqe->op){
+  case IORING_OP_READ:
+    return fileread(f, sqe->addr, sqe->len);
+  case IORING_OP_WRITE:
+    return filewrite(f, sqe->addr, sqe->len);
+  case IORING_OP_FSTAT:
+    return filestat(f, sqe->addr);
+  }
+  return -1;
+}
+
+// Consume up to n entries from the submission ring, in order,
+// posting a completion for each.  Stops early if the ring is
+// empty or the completion ring is full.  Returns the number
+// of entries consumed.
+// The entries run here, in the caller, rather than in a kernel
+// thread (see kthread()): they name the caller's file
+// descriptors and user memory, and a kernel thread has neither
+// its file table nor its page table.
+uint64
+sys_ringenter(void)
+{
+  struct proc *p = myproc();
+  struct ioring *r = p->ioring;
+  struct iosqe sqe;
+  struct iocqe *cqe;
+  int n, done;
+
+  argint(0, &n);
+  if(r == 0)
+    return -1;
+
+  for(done = 0; done < n; done++){
+    __sync_synchronize();
+    if(r->sqhead == r->sqtail || r->cqtail - r->cqhead >= IORING_NCQE)
+      break;
+    // copy the entry, since user code can change it under us.
+    sqe = r->sq[r->sqhead % IORING_NSQE];
+    r->sqhead++;
+    cqe = &r->cq[r->cqtail % IORING_NCQE];
+    cqe->user_data = sqe.user_data;
+    cqe->res = ioring_op(&sqe);
+    // publish the completion only once it is filled in.
+    __sync_synchronize();
+    r->cqtail++;
+  }
+  return done;
+}
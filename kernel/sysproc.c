@@ -4,6 +4,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
+#include "seqlock.h"
 #include "proc.h"
 
 uint64
@@ -52,20 +53,13 @@ uint64
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   argint(0, &n);
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(killed(myproc())){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  if(n < 0)
+    n = 0;
+  // n ticks' worth of time, so that only this process's
+  // deadline wakes it, not every tick.
+  return sleepuntil(r_time() + (uint64)n * TICKINTERVAL);
 }
 
 uint64
@@ -82,10 +76,24 @@ sys_kill(void)
 uint64
 sys_uptime(void)
 {
-  uint xticks;
+  uint xticks, s;
 
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
+  do {
+    s = readseqbegin(&tickseq);
+    xticks = ticks;
+  } while(readseqretry(&tickseq, s));
   return xticks;
 }
+
+// put the calling process in the real-time (EDF) class,
+// with a budget of CPU ticks in every period of ticks.
+// a zero period returns it to round-robin.
+uint64
+sys_rtsched(void)
+{
+  int period, budget;
+
+  argint(0, &period);
+  argint(1, &budget);
+  return rtsched(period, budget);
+}
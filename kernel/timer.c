@@ -0,0 +1,305 @@
+//
+// High-resolution time and one-shot timers.
+//
+// The time CSR counts at TIMEFREQ Hz. Each hart has a single
+// timer comparator, shared between the periodic scheduling
+// tick and a one-shot deadline set with timerset().
+//
+// With the Sstc extension, the comparator is stimecmp, and
+// supervisor mode programs it directly and takes supervisor
+// timer interrupts. Otherwise it is the CLINT's mtimecmp:
+// timervec in kernelvec.S multiplexes it in machine mode and
+// forwards each expiry as a supervisor software interrupt.
+// Either way devintr() calls timerintr() to find out what
+// happened.
+//
+// Processes waiting with a deadline (see sleeptimeout() in
+// proc.c) sit in a min-heap ordered by deadline, and the hart
+// that changes the earliest deadline arms its one-shot for it.
+// So each sleeper is woken once, when its deadline passes,
+// rather than on every tick.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NSPERCYCLE (1000000000 / TIMEFREQ)
+
+// see timerinit() in start.c for the layout.
+extern uint64 timer_scratch[NCPU][8];
+
+// set by start() if stimecmp is available.
+extern int sstc;
+
+// earliest one-shot deadline armed on each hart, or 0.
+static uint64 armed[NCPU];
+
+// with Sstc, time of each hart's next periodic tick.
+static uint64 nexttick[NCPU];
+
+// lock order: a sleeptimeout() caller's lock, then timers.lock,
+// then p->lock. never acquire timers.lock while holding a p->lock.
+struct {
+  struct spinlock lock;
+  struct proc *heap[NPROC+1];   // heap[1..n], earliest deadline first
+  int n;
+  volatile uint64 next;         // heap[1]->timeout, or 0 if empty
+  struct spinlock sleeplk;      // for sleepuntil()'s sleeptimeout()
+} timers;
+
+void
+hrtimerinit(void)
+{
+  initlock(&timers.lock, "timers");
+  initlock(&timers.sleeplk, "sleepuntil");
+}
+
+// start this hart's periodic tick, if using Sstc;
+// otherwise timerinit() in start.c has done so.
+void
+timerinithart(void)
+{
+  int id = cpuid();
+
+  if(sstc){
+    nexttick[id] = r_time() + TICKINTERVAL;
+    w_stimecmp(nexttick[id]);
+  }
+}
+
+// nanoseconds since boot.
+uint64
+nanotime(void)
+{
+  return r_time() * NSPERCYCLE;
+}
+
+// Ask for a timer interrupt on this hart at time when, in time
+// CSR cycles, unless one is already due before then.
+// Interrupts must be off, so that we stay on this hart.
+void
+timerset(uint64 when)
+{
+  int id = cpuid();
+  uint64 *scratch = timer_scratch[id];
+  volatile uint64 *mtimecmp = (uint64*)CLINT_MTIMECMP(id);
+
+  if(armed[id] != 0 && armed[id] <= when)
+    return;
+  armed[id] = when;
+  if(sstc){
+    if(when < r_stimecmp())
+      w_stimecmp(when);
+    return;
+  }
+  // timervec reads scratch[6] on every interrupt, so it takes
+  // effect even if the interrupt below happens first. at worst
+  // a racing timervec makes the periodic tick a little late.
+  if(scratch[6] == 0 || when < scratch[6])
+    scratch[6] = when;
+  if(when < *mtimecmp)
+    *mtimecmp = when;
+}
+
+static void
+heapswap(int i, int j)
+{
+  struct proc *t = timers.heap[i];
+
+  timers.heap[i] = timers.heap[j];
+  timers.heap[j] = t;
+  timers.heap[i]->timeridx = i;
+  timers.heap[j]->timeridx = j;
+}
+
+// restore heap order around index i.
+static void
+heapfix(int i)
+{
+  int c;
+
+  while(i > 1 && timers.heap[i]->timeout < timers.heap[i/2]->timeout){
+    heapswap(i, i/2);
+    i /= 2;
+  }
+  while((c = 2*i) <= timers.n){
+    if(c+1 <= timers.n && timers.heap[c+1]->timeout < timers.heap[c]->timeout)
+      c++;
+    if(timers.heap[i]->timeout <= timers.heap[c]->timeout)
+      break;
+    heapswap(i, c);
+    i = c;
+  }
+}
+
+static void
+heapremove(struct proc *p)
+{
+  int i = p->timeridx;
+
+  p->timeridx = 0;
+  if(i != timers.n){
+    timers.heap[i] = timers.heap[timers.n];
+    timers.heap[i]->timeridx = i;
+    timers.n--;
+    heapfix(i);
+  } else {
+    timers.n--;
+  }
+}
+
+// keep timers.next and this hart's one-shot up to date
+// with the earliest deadline. timers.lock must be held.
+static void
+timerrearm(void)
+{
+  if(timers.n == 0){
+    timers.next = 0;
+    return;
+  }
+  if(timers.next != timers.heap[1]->timeout){
+    timers.next = timers.heap[1]->timeout;
+    timerset(timers.next);
+  }
+}
+
+// Queue p to be woken at deadline.
+// Caller must not hold p->lock.
+void
+timeradd(struct proc *p, uint64 deadline)
+{
+  acquire(&timers.lock);
+  if(p->timeridx)
+    heapremove(p);
+  p->timeout = deadline;
+  p->timeridx = ++timers.n;
+  timers.heap[p->timeridx] = p;
+  heapfix(p->timeridx);
+  timerrearm();
+  release(&timers.lock);
+}
+
+// Take p off the heap, if its deadline has not already passed.
+// Caller must not hold p->lock.
+void
+timerdel(struct proc *p)
+{
+  acquire(&timers.lock);
+  if(p->timeridx){
+    heapremove(p);
+    timerrearm();
+  }
+  release(&timers.lock);
+}
+
+// Wake every process whose deadline has passed.
+static void
+timerexpire(void)
+{
+  struct proc *p;
+
+  acquire(&timers.lock);
+  while(timers.n > 0 && timers.heap[1]->timeout <= r_time()){
+    p = timers.heap[1];
+    heapremove(p);
+    acquire(&p->lock);
+    p->timedout = 1;
+    if(p->state == SLEEPING)
+      wakeproc(p);
+    release(&p->lock);
+  }
+  // arm this hart for the new earliest deadline, even if it
+  // was armed elsewhere: that hart's one-shot may have fired.
+  timers.next = 0;
+  timerrearm();
+  release(&timers.lock);
+}
+
+// Called by devintr() for each timer software interrupt.
+// Wakes processes whose deadlines have passed, and returns
+// the number of periodic ticks since the last call.
+int
+timerintr(void)
+{
+  int id = cpuid();
+  uint64 n, next, now, due;
+
+  now = r_time();
+  if(sstc){
+    // count the ticks that are due, then program stimecmp for
+    // the earlier of the next tick and the one-shot. writing
+    // stimecmp also clears the pending interrupt.
+    for(n = 0; nexttick[id] <= now; n++)
+      nexttick[id] += TICKINTERVAL;
+    if(armed[id] != 0 && now >= armed[id])
+      armed[id] = 0;
+    due = nexttick[id];
+    if(armed[id] != 0 && armed[id] < due)
+      due = armed[id];
+    w_stimecmp(due);
+  } else {
+    // timervec increments scratch[7] in machine mode;
+    // an atomic swap cannot lose an increment.
+    n = __sync_lock_test_and_set(&timer_scratch[id][7], 0);
+    if(armed[id] != 0 && now >= armed[id])
+      armed[id] = 0;
+  }
+
+  // a cheap unlocked check first; the periodic tick on every
+  // hart also serves as a backstop for the one-shot.
+  next = timers.next;
+  if(next != 0 && next <= now)
+    timerexpire();
+  return n;
+}
+
+// clock_gettime(uint64 *ns)
+// store nanoseconds since boot at ns.
+uint64
+sys_clock_gettime(void)
+{
+  uint64 addr, ns;
+
+  argaddr(0, &addr);
+  ns = nanotime();
+  if(copyout(myproc()->pagetable, addr, (char*)&ns, sizeof(ns)) < 0)
+    return -1;
+  return 0;
+}
+
+// Sleep until deadline, in time CSR cycles.
+// Returns -1 if killed.
+int
+sleepuntil(uint64 deadline)
+{
+  int r = 0;
+
+  // nothing wakes this channel; only the deadline or kill().
+  acquire(&timers.sleeplk);
+  while(r_time() < deadline){
+    if(killed(myproc())){
+      r = -1;
+      break;
+    }
+    sleeptimeout(&timers, &timers.sleeplk, deadline);
+  }
+  release(&timers.sleeplk);
+  return r;
+}
+
+// nanosleep(uint64 ns)
+// sleep for at least ns nanoseconds, using a one-shot timer
+// rather than waiting for whole ticks.
+uint64
+sys_nanosleep(void)
+{
+  uint64 ns;
+
+  argaddr(0, &ns);
+  return sleepuntil(r_time() + (ns + NSPERCYCLE - 1) / NSPERCYCLE);
+}
@@ -0,0 +1,137 @@
+//
+// System call tracing and latency histograms.
+//
+// syscall() times every system call with the time CSR and
+// counts it in a per-CPU log2 histogram, which is always on.
+// Calls selected by the process's trace mask (see trace())
+// are also logged, with arguments, return value and duration,
+// in a per-CPU ring that traceread() drains.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "trace.h"
+#include "defs.h"
+
+struct {
+  struct spinlock lock;
+  struct tracerec rec[NTRACE];
+  uint head;  // next record to read
+  uint tail;  // next record to write
+} tring[NCPU];
+
+// hist[cpu][num][bucket] counts calls of num that finished on cpu.
+static uint hist[NCPU][NSYSCALL][NHISTBUCKET];
+
+void
+traceinit(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    initlock(&tring[i].lock, "trace");
+}
+
+// Count a call of system call num that took cycles.
+void
+syscall_hist(int num, uint64 cycles)
+{
+  int b;
+
+  for(b = 0; b < NHISTBUCKET-1 && cycles >= 2; b++)
+    cycles >>= 1;
+  push_off();
+  hist[cpuid()][num][b]++;
+  pop_off();
+}
+
+// Log a traced system call, with its first three arguments
+// as they were on entry, in this CPU's ring, overwriting the
+// oldest record if the ring is full.
+void
+syscall_trace(struct proc *p, int num, uint64 *args, uint64 ret, uint64 cycles)
+{
+  struct tracerec *r;
+
+  push_off();
+  int id = cpuid();
+  acquire(&tring[id].lock);
+  if(tring[id].tail - tring[id].head == NTRACE)
+    tring[id].head++;
+  r = &tring[id].rec[tring[id].tail++ % NTRACE];
+  r->pid = p->pid;
+  r->num = num;
+  r->args[0] = args[0];
+  r->args[1] = args[1];
+  r->args[2] = args[2];
+  r->ret = ret;
+  r->cycles = cycles;
+  release(&tring[id].lock);
+  pop_off();
+}
+
+// Trace the system calls whose bits are set in mask, in the
+// calling process and in children it forks from now on.
+uint64
+sys_trace(void)
+{
+  uint64 mask;
+
+  argaddr(0, &mask);
+  myproc()->tracemask = mask;
+  return 0;
+}
+
+// Move up to n trace records, oldest first within each CPU,
+// into the user array of struct tracerec at addr.
+// Returns the number of records copied.
+uint64
+sys_traceread(void)
+{
+  uint64 addr;
+  int n, i, got = 0;
+  struct tracerec *r;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  for(i = 0; i < NCPU && got < n; i++){
+    acquire(&tring[i].lock);
+    // copyout() does not sleep, so like wait() and consoleread()
+    // hold the lock across it; syscall_trace() cannot then drop
+    // the record being copied.
+    while(got < n && tring[i].head != tring[i].tail){
+      r = &tring[i].rec[tring[i].head % NTRACE];
+      if(copyout(myproc()->pagetable, addr + got*sizeof(*r), (char*)r, sizeof(*r)) < 0){
+        release(&tring[i].lock);
+        return -1;
+      }
+      got++;
+      tring[i].head++;
+    }
+    release(&tring[i].lock);
+  }
+  return got;
+}
+
+// Copy the latency histograms, summed over CPUs, to the
+// user array uint[NSYSCALL][NHISTBUCKET] at addr.
+uint64
+sys_syshist(void)
+{
+  uint64 addr;
+  uint row[NHISTBUCKET];
+  int i, n, b;
+
+  argaddr(0, &addr);
+  for(n = 0; n < NSYSCALL; n++){
+    memset(row, 0, sizeof(row));
+    for(i = 0; i < NCPU; i++)
+      for(b = 0; b < NHISTBUCKET; b++)
+        row[b] += hist[i][n][b];
+    if(copyout(myproc()->pagetable, addr + n*sizeof(row), (char*)row, sizeof(row)) < 0)
+      return -1;
+  }
+  return 0;
+}
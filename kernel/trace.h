@@ -0,0 +1,17 @@
+// System call tracing and latency histograms.
+// Both the kernel and user programs use this header file.
+
+#define NSYSCALL    64  // bits in a trace mask
+#define NTRACE     128  // records in each CPU's trace ring
+#define NHISTBUCKET 24  // latency buckets: bucket i counts calls
+                        // taking [2^i, 2^(i+1)) cycles; the last
+                        // bucket also counts anything slower.
+
+// one traced system call, as returned by traceread().
+struct tracerec {
+  int pid;
+  int num;          // system call number
+  uint64 args[3];   // first three arguments
+  uint64 ret;       // return value
+  uint64 cycles;    // duration, in time CSR cycles
+};
@@ -3,10 +3,11 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "seqlock.h"
 #include "proc.h"
 #include "defs.h"
 
-struct spinlock tickslock;
+struct seqlock tickseq;  // writers update ticks
 uint ticks;
 
 extern char trampoline[], uservec[], userret[];
@@ -19,7 +20,7 @@ extern int devintr();
 void
 trapinit(void)
 {
-  initlock(&tickslock, "time");
+  initseqlock(&tickseq, "time");
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -76,9 +77,13 @@ usertrap(void)
   if(killed(p))
     exit(-1);
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
-    yield();
+  // sample for the profiler and give up the CPU if this is
+  // a timer interrupt that ends the process's time slice.
+  if(which_dev == 2){
+    profuser(p);
+    if(timeslice())
+      yield();
+  }
 
   usertrapret();
 }
@@ -150,8 +155,12 @@ kerneltrap()
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING)
+  // sample for the kernel profiler and give up the CPU if
+  // this is a timer interrupt that ends the time slice.
+  if(which_dev == 2)
+    profkernel(sepc, (uint64*)r_fp());
+  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING &&
+     timeslice())
     yield();
 
   // the yield() may have caused some traps to occur,
@@ -160,18 +169,19 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
+// advance ticks by n.
 void
-clockintr()
+clockintr(int n)
 {
-  acquire(&tickslock);
-  ticks++;
-  wakeup(&ticks);
-  release(&tickslock);
+  acquireseq(&tickseq);
+  ticks += n;
+  releaseseq(&tickseq);
+  usyscall_ticks(ticks);
 }
 
 // check if it's an external interrupt or software interrupt,
 // and handle it.
-// returns 2 if timer interrupt,
+// returns 2 if periodic timer interrupt,
 // 1 if other device,
 // 0 if not recognized.
 int
@@ -201,17 +211,30 @@ devintr()
       plic_complete(irq);
 
     return 1;
-  } else if(scause == 0x8000000000000001L){
+  } else if(scause == 0x8000000000000001L ||
+            scause == 0x8000000000000005L){
     // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
+    // forwarded by timervec in kernelvec.S, or a supervisor
+    // timer interrupt from stimecmp (see timer.c).
+
+    // acknowledge the software interrupt by clearing
+    // the SSIP bit in sip. timerintr() acknowledges a
+    // stimecmp interrupt by moving stimecmp.
+    if(scause == 0x8000000000000001L)
+      w_sip(r_sip() & ~2);
+
+    // a one-shot timer (see timer.c) may have expired
+    // without a periodic tick being due.
+    int n = timerintr();
+    if(n == 0)
+      return 1;
 
     if(cpuid() == 0){
-      clockintr();
+      clockintr(n);
     }
-    
-    // acknowledge the software interrupt by clearing
-    // the SSIP bit in sip.
-    w_sip(r_sip() & ~2);
+
+    // charge a real-time process for the ticks it used.
+    rtcharge(n);
 
     return 2;
   } else {
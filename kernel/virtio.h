@@ -47,7 +47,8 @@
 
 // this many virtio descriptors.
 // must be a power of two.
-#define NUM 8
+// room for a few requests of MAXRUN blocks each.
+#define NUM 64
 
 // a single descriptor, from the spec.
 struct virtq_desc {
@@ -40,6 +40,7 @@ static struct disk {
 
   // our own book-keeping.
   char free[NUM];  // is a descriptor free?
+  struct waitq freeq; // processes waiting for free descriptors
   uint16 used_idx; // we've looked this far in used[2..NUM].
 
   // track info about in-flight operations,
@@ -48,6 +49,8 @@ static struct disk {
   struct {
     struct buf *b;
     char status;
+    char async;    // nobody waits; pass b to bdone()
+    int *left;     // requests of a batch still in flight
   } info[NUM];
 
   // disk command headers.
@@ -178,13 +181,16 @@ free_desc(int i)
   disk.desc[i].flags = 0;
   disk.desc[i].next = 0;
   disk.free[i] = 1;
-  wakeup(&disk.free[0]);
 }
 
-// free a chain of descriptors.
+// free a chain of descriptors, and wake as many waiters
+// as the free descriptors cover, each having said in
+// submit() how many it needs.
 static void
 free_chain(int i)
 {
+  int nfree = 0;
+
   while(1){
     int flag = disk.desc[i].flags;
     int nxt = disk.desc[i].next;
@@ -194,14 +200,16 @@ free_chain(int i)
     else
       break;
   }
+  for(i = 0; i < NUM; i++)
+    nfree += disk.free[i];
+  wakeupqn(&disk.freeq, nfree, 1);
 }
 
-// allocate three descriptors (they need not be contiguous).
-// disk transfers always use three descriptors.
+// allocate n descriptors (they need not be contiguous).
 static int
-alloc3_desc(int *idx)
+allocn_desc(int *idx, int n)
 {
-  for(int i = 0; i < 3; i++){
+  for(int i = 0; i < n; i++){
     idx[i] = alloc_desc();
     if(idx[i] < 0){
       for(int j = 0; j < i; j++)
@@ -212,27 +220,34 @@ alloc3_desc(int *idx)
   return 0;
 }
 
-void
-virtio_disk_rw(struct buf *b, int write)
+// queue a request to read or write the n bufs in bs from or
+// to the consecutive blocks starting at blockno, and return the
+// index of its first descriptor; or -1 if there are no free
+// descriptors and the caller asked not to wait for them.
+// caller holds disk.vdisk_lock.
+static int
+submit(struct buf **bs, int n, uint blockno, int write, int nowait)
 {
-  uint64 sector = b->blockno * (BSIZE / 512);
+  uint64 sector = blockno * (BSIZE / 512);
+  int i;
 
-  acquire(&disk.vdisk_lock);
+  if(n < 1 || n > MAXRUN)
+    panic("virtio submit");
 
   // the spec's Section 5.2 says that legacy block operations use
-  // three descriptors: one for type/reserved/sector, one for the
-  // data, one for a 1-byte status result.
-
-  // allocate the three descriptors.
-  int idx[3];
+  // one descriptor for type/reserved/sector, then the data, here
+  // one descriptor per buf, then one for a 1-byte status result.
+  int idx[MAXRUN+2];
   while(1){
-    if(alloc3_desc(idx) == 0) {
+    if(allocn_desc(idx, n+2) == 0) {
       break;
     }
-    sleep(&disk.free[0], &disk.vdisk_lock);
+    if(nowait)
+      return -1;
+    sleepqn(&disk.freeq, &disk.vdisk_lock, n+2);
   }
 
-  // format the three descriptors.
+  // format the descriptors.
   // qemu's virtio-blk.c reads them.
 
   struct virtio_blk_req *buf0 = &disk.ops[idx[0]];
@@ -249,24 +264,27 @@ virtio_disk_rw(struct buf *b, int write)
   disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
   disk.desc[idx[0]].next = idx[1];
 
-  disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
-  if(write)
-    disk.desc[idx[1]].flags = 0; // device reads b->data
-  else
-    disk.desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
-  disk.desc[idx[1]].flags |= VRING_DESC_F_NEXT;
-  disk.desc[idx[1]].next = idx[2];
+  for(i = 1; i <= n; i++){
+    disk.desc[idx[i]].addr = (uint64) bs[i-1]->data;
+    disk.desc[idx[i]].len = BSIZE;
+    if(write)
+      disk.desc[idx[i]].flags = 0; // device reads b->data
+    else
+      disk.desc[idx[i]].flags = VRING_DESC_F_WRITE; // device writes b->data
+    disk.desc[idx[i]].flags |= VRING_DESC_F_NEXT;
+    disk.desc[idx[i]].next = idx[i+1];
+  }
 
   disk.info[idx[0]].status = 0xff; // device writes 0 on success
-  disk.desc[idx[2]].addr = (uint64) &disk.info[idx[0]].status;
-  disk.desc[idx[2]].len = 1;
-  disk.desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
-  disk.desc[idx[2]].next = 0;
+  disk.desc[idx[n+1]].addr = (uint64) &disk.info[idx[0]].status;
+  disk.desc[idx[n+1]].len = 1;
+  disk.desc[idx[n+1]].flags = VRING_DESC_F_WRITE; // device writes the status
+  disk.desc[idx[n+1]].next = 0;
 
-  // record struct buf for virtio_disk_intr().
-  b->disk = 1;
-  disk.info[idx[0]].b = b;
+  // record the first struct buf for virtio_disk_intr();
+  // the waiter, if any, waits on it for the whole request.
+  bs[0]->disk = 1;
+  disk.info[idx[0]].b = bs[0];
 
   // tell the device the first index in our chain of descriptors.
   disk.avail->ring[disk.avail->idx % NUM] = idx[0];
@@ -280,17 +298,85 @@ virtio_disk_rw(struct buf *b, int write)
 
   *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
 
+  return idx[0];
+}
+
+// read or write the n bufs in bs from or to the blocks
+// starting at blockno with one request, and wait for it
+// to finish.
+static void
+rw(struct buf **bs, int n, uint blockno, int write)
+{
+  int id;
+
+  acquire(&disk.vdisk_lock);
+
+  id = submit(bs, n, blockno, write, 0);
+
   // Wait for virtio_disk_intr() to say request has finished.
-  while(b->disk == 1) {
-    sleep(b, &disk.vdisk_lock);
+  while(bs[0]->disk == 1) {
+    sleep(bs[0], &disk.vdisk_lock);
   }
 
-  disk.info[idx[0]].b = 0;
-  free_chain(idx[0]);
+  disk.info[id].b = 0;
+  free_chain(id);
 
   release(&disk.vdisk_lock);
 }
 
+// read or write the n bufs in bs, which must hold consecutive
+// blocks, with one request, and wait for it to finish.
+void
+virtio_disk_rwn(struct buf **bs, int n, int write)
+{
+  rw(bs, n, bs[0]->blockno, write);
+}
+
+void
+virtio_disk_rw(struct buf *b, int write)
+{
+  rw(&b, 1, b->blockno, write);
+}
+
+// write the data of the n bufs in bs to the consecutive
+// blocks starting at blockno, rather than to their own
+// blocks, with a request per MAXRUN of them, and wait for
+// them all to finish. every request is queued before any is
+// waited for; virtio_disk_intr() frees each one's descriptors
+// as it finishes, so that the rest can be queued.
+void
+virtio_disk_writeat(struct buf **bs, int n, uint blockno)
+{
+  int i, m, id, left = 0;
+
+  acquire(&disk.vdisk_lock);
+  for(i = 0; i < n; i += m){
+    m = n - i < MAXRUN ? n - i : MAXRUN;
+    id = submit(&bs[i], m, blockno + i, 1, 0);
+    disk.info[id].left = &left;
+    left++;
+  }
+  while(left > 0)
+    sleep(&left, &disk.vdisk_lock);
+  release(&disk.vdisk_lock);
+}
+
+// Start reading b, which must be locked, and return without
+// waiting: virtio_disk_intr() hands b to bdone() once the data
+// is in. Returns -1, without starting, if the disk's queue is
+// full, since read-ahead is not worth waiting for.
+int
+virtio_disk_read_async(struct buf *b)
+{
+  int id;
+
+  acquire(&disk.vdisk_lock);
+  if((id = submit(&b, 1, b->blockno, 0, 1)) >= 0)
+    disk.info[id].async = 1;
+  release(&disk.vdisk_lock);
+  return id < 0 ? -1 : 0;
+}
+
 void
 virtio_disk_intr()
 {
@@ -318,7 +404,20 @@ virtio_disk_intr()
 
     struct buf *b = disk.info[id].b;
     b->disk = 0;   // disk is done with buf
-    wakeup(b);
+    if(disk.info[id].async){
+      disk.info[id].async = 0;
+      disk.info[id].b = 0;
+      free_chain(id);
+      bdone(b);
+    } else if(disk.info[id].left){
+      if(--*disk.info[id].left == 0)
+        wakeup(disk.info[id].left);
+      disk.info[id].left = 0;
+      disk.info[id].b = 0;
+      free_chain(id);
+    } else {
+      wakeup(b);
+    }
 
     disk.used_idx += 1;
   }
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+
+# Symbolize samples printed by the xv6 "prof" and "kprof" programs
+# and print a flat profile and a call graph, or folded stacks for
+# flamegraph.pl.
+#
+# usage: make qemu | tee console.out     (then run "prof cmd" in xv6)
+#        ./prof.py user/_cmd.sym console.out
+#
+#        make qemu | tee console.out     (then run "kprof cmd" in xv6)
+#        ./prof.py -k console.out        (uses kernel/kernel.sym)
+#        ./prof.py -k --folded console.out | flamegraph.pl > kernel.svg
+#
+# Each "prof: pc ra1 ra2 ..." (or "kprof: ...") line in the input
+# is one sample, innermost pc first.
+
+import sys, re, bisect
+from optparse import OptionParser
+
+class Symbols:
+    """Nearest-preceding-symbol lookup in a .sym file made by the
+    Makefile (one "address name" pair per line)."""
+
+    def __init__(self, path):
+        syms = []
+        for line in open(path):
+            parts = line.split()
+            if len(parts) != 2:
+                continue
+            addr, name = parts
+            # skip sections, source file names and local labels.
+            if name.startswith(".") or re.search(r"\.[cS]$", name) or name.startswith("$"):
+                continue
+            syms.append((int(addr, 16), name))
+        syms.sort()
+        self.addrs = [a for a, _ in syms]
+        self.names = [n for _, n in syms]
+
+    def lookup(self, pc):
+        i = bisect.bisect_right(self.addrs, pc) - 1
+        if i < 0:
+            return "0x%x" % pc
+        return self.names[i]
+
+def read_samples(f, prefix):
+    """Yield each sample in f as a list of pcs, innermost first."""
+    for line in f:
+        line = line.strip()
+        if not line.startswith(prefix):
+            continue
+        try:
+            pcs = [int(w, 16) for w in line[len(prefix):].split()]
+        except ValueError:
+            continue          # "begin"/"end" lines
+        if pcs:
+            yield pcs
+
+def symbolize(syms, pcs):
+    """Map a sample to function names, innermost first. A return
+    address points after its call, so look up ra-1 instead."""
+    return [syms.lookup(pc if i == 0 else pc - 1) for i, pc in enumerate(pcs)]
+
+def report(stacks, graph=True, out=sys.stdout):
+    n = len(stacks)
+    if n == 0:
+        print("no samples", file=out)
+        return
+    self_count = {}
+    total_count = {}
+    callers = {}               # callee -> {caller: count}
+    callees = {}               # caller -> {callee: count}
+    for stack in stacks:
+        self_count[stack[0]] = self_count.get(stack[0], 0) + 1
+        # count recursive functions once per sample.
+        for fn in set(stack):
+            total_count[fn] = total_count.get(fn, 0) + 1
+        for callee, caller in zip(stack, stack[1:]):
+            d = callers.setdefault(callee, {})
+            d[caller] = d.get(caller, 0) + 1
+            d = callees.setdefault(caller, {})
+            d[callee] = d.get(callee, 0) + 1
+
+    print("flat profile: %d samples" % n, file=out)
+    print("%7s %7s  %s" % ("self%", "total%", "function"), file=out)
+    for fn in sorted(total_count, key=lambda f: (-self_count.get(f, 0), -total_count[f])):
+        print("%6.1f%% %6.1f%%  %s" % (100.0 * self_count.get(fn, 0) / n,
+                                       100.0 * total_count[fn] / n, fn), file=out)
+
+    if not graph:
+        return
+    print("", file=out)
+    print("call graph (callers above, callees below each function)", file=out)
+    for fn in sorted(total_count, key=lambda f: -total_count[f]):
+        print("", file=out)
+        for caller, c in sorted(callers.get(fn, {}).items(), key=lambda x: -x[1]):
+            print("        %6d  %s" % (c, caller), file=out)
+        print("  %6d self %6d total  %s" % (self_count.get(fn, 0), total_count[fn], fn), file=out)
+        for callee, c in sorted(callees.get(fn, {}).items(), key=lambda x: -x[1]):
+            print("        %6d  %s" % (c, callee), file=out)
+
+def folded(stacks, out=sys.stdout):
+    """Print one "outer;...;inner count" line per distinct stack."""
+    counts = {}
+    for stack in stacks:
+        key = ";".join(reversed(stack))
+        counts[key] = counts.get(key, 0) + 1
+    for key in sorted(counts):
+        print("%s %d" % (key, counts[key]), file=out)
+
+def main():
+    parser = OptionParser(usage="usage: %prog [options] [file.sym] [console.out]")
+    parser.add_option("-f", "--flat", action="store_true",
+                      help="print only the flat profile")
+    parser.add_option("-k", "--kernel", action="store_true",
+                      help="read kprof samples; file.sym defaults to kernel/kernel.sym")
+    parser.add_option("--folded", action="store_true",
+                      help="print folded stacks for flamegraph.pl")
+    (options, args) = parser.parse_args()
+    if options.kernel and (len(args) == 0 or not args[0].endswith(".sym")):
+        args.insert(0, "kernel/kernel.sym")
+    if len(args) < 1 or len(args) > 2:
+        parser.error("need a .sym file")
+    syms = Symbols(args[0])
+    f = open(args[1]) if len(args) == 2 else sys.stdin
+    prefix = "kprof:" if options.kernel else "prof:"
+    stacks = [symbolize(syms, pcs) for pcs in read_samples(f, prefix)]
+    if options.folded:
+        folded(stacks)
+    else:
+        report(stacks, graph=not options.flat)
+
+if __name__ == "__main__":
+    main()
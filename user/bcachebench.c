@@ -0,0 +1,120 @@
+//
+// read different files in parallel, one per process, and
+// report the read rate, buffer cache lock contention and hit
+// rate. by default the files fit in the cache together, so the
+// reads are all cache hits, and processes on different harts
+// only share bcache's locks; with more blocks per file, the
+// cache must grow to hold them.
+//
+// usage: bcachebench [nproc [ticks [nblock]]]
+//
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define MAXPROC 8
+
+char buf[512];
+char report[4096];
+
+// print the report line for lock name.
+void
+printlock(char *name)
+{
+  char *p = report, *e;
+  int n = strlen(name);
+
+  while(*p){
+    for(e = p; *e && *e != '\n'; e++)
+      ;
+    if(memcmp(p, name, n) == 0 && p[n] == ' '){
+      write(1, "  ", 2);
+      write(1, p, e - p + 1);
+      return;
+    }
+    p = *e ? e + 1 : e;
+  }
+  printf("  %s: no contention recorded\n", name);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nproc = 4, ticks = 20, nblock = 3;
+  int i, j, n, fd, fds[2], start, end, total;
+  char name[] = "bcachebench.0";
+
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(argc > 2)
+    ticks = atoi(argv[2]);
+  if(argc > 3)
+    nblock = atoi(argv[3]);
+  if(nproc < 1 || nproc > MAXPROC || ticks < 1 || nblock < 1){
+    fprintf(2, "usage: bcachebench [nproc (1-%d) [ticks [nblock]]]\n", MAXPROC);
+    exit(1);
+  }
+
+  for(i = 0; i < nproc; i++){
+    name[12] = '0' + i;
+    if((fd = open(name, O_CREATE | O_WRONLY | O_TRUNC)) < 0){
+      fprintf(2, "bcachebench: cannot create %s\n", name);
+      exit(1);
+    }
+    for(j = 0; j < nblock; j++)
+      write(fd, buf, sizeof(buf));
+    close(fd);
+  }
+  if(pipe(fds) < 0){
+    fprintf(2, "bcachebench: pipe failed\n");
+    exit(1);
+  }
+
+  statsclear();
+  start = uptime() + 1;
+  end = start + ticks;
+  for(i = 0; i < nproc; i++){
+    if(fork() == 0){
+      close(fds[0]);
+      name[12] = '0' + i;
+      if((fd = open(name, O_RDONLY)) < 0){
+        fprintf(2, "bcachebench: cannot open %s\n", name);
+        exit(1);
+      }
+      while(uptime() < start)
+        ;
+      for(n = 0; uptime() < end; n++){
+        if(read(fd, buf, sizeof(buf)) != sizeof(buf)){
+          // start over at the beginning of the file.
+          close(fd);
+          fd = open(name, O_RDONLY);
+        }
+      }
+      write(fds[1], &n, sizeof(n));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+  total = 0;
+  for(i = 0; i < nproc; i++){
+    if(read(fds[0], &n, sizeof(n)) == sizeof(n))
+      total += n;
+    wait(0);
+  }
+  close(fds[0]);
+
+  n = statistics(report, sizeof(report) - 1);
+  report[n < 0 ? 0 : n] = 0;
+  printf("bcachebench: %d procs, %d blocks each, %d reads/tick\n",
+         nproc, nblock, total / ticks);
+  printlock("bcache");
+  printlock("bcache.bucket");
+  printlock("bcache:");
+
+  for(i = 0; i < nproc; i++){
+    name[12] = '0' + i;
+    unlink(name);
+  }
+  exit(0);
+}
@@ -0,0 +1,146 @@
+//
+// compare buffer cache replacement policies (build with and
+// without BCACHELRU=1) on a mix of metadata and streaming:
+// each round looks up and reads a set of small files, then
+// reads a large file through, as cat or grep would.
+//
+// usage: cachebench [npages]
+//
+// to make the cache smaller than the large file, cachebench
+// first uses up free memory, which makes kalloc() take pages
+// back from the cache, then gives npages (default 16) back
+// for the cache to grow into again.
+//
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "user/user.h"
+
+#define NSMALL  24             // small files
+#define NBIG    (MAXFILE - 8)  // blocks in the large file
+#define NROUND  4
+
+char buf[BSIZE];
+char report[4096];
+char name[] = "cb/f00";
+
+// print the report line starting with s.
+void
+printline(char *s)
+{
+  char *p = report, *e;
+  int n = strlen(s);
+
+  while(*p){
+    for(e = p; *e && *e != '\n'; e++)
+      ;
+    if(memcmp(p, s, n) == 0){
+      write(1, "    ", 4);
+      write(1, p, e - p + 1);
+      return;
+    }
+    p = *e ? e + 1 : e;
+  }
+}
+
+void
+setname(int i)
+{
+  name[4] = '0' + i / 10;
+  name[5] = '0' + i % 10;
+}
+
+void
+create(char *path, int nblock)
+{
+  int fd, i;
+
+  if((fd = open(path, O_CREATE | O_WRONLY | O_TRUNC)) < 0){
+    fprintf(2, "cachebench: cannot create %s\n", path);
+    exit(1);
+  }
+  for(i = 0; i < nblock; i++){
+    if(write(fd, buf, BSIZE) != BSIZE){
+      fprintf(2, "cachebench: write %s failed\n", path);
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+// read path through, 512 bytes at a time.
+void
+readall(char *path)
+{
+  int fd;
+
+  if((fd = open(path, O_RDONLY)) < 0){
+    fprintf(2, "cachebench: cannot open %s\n", path);
+    exit(1);
+  }
+  while(read(fd, buf, 512) > 0)
+    ;
+  close(fd);
+}
+
+// use up free memory, and then give npages back.
+void
+squeeze(int npages)
+{
+  while(sbrk(64*4096) != (char*)-1)
+    ;
+  while(sbrk(4096) != (char*)-1)
+    ;
+  sbrk(-npages*4096);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int npages = 16, i, r, n;
+  uint64 t0, t1, t2;
+
+  if(argc > 1)
+    npages = atoi(argv[1]);
+  if(npages < 0){
+    fprintf(2, "usage: cachebench [npages]\n");
+    exit(1);
+  }
+
+  mkdir("cb");
+  for(i = 0; i < NSMALL; i++){
+    setname(i);
+    create(name, 1);
+  }
+  create("cb/big", NBIG);
+  squeeze(npages);
+
+  printf("cachebench: %d small files, %d-block file, cache of %d extra pages\n",
+         NSMALL, NBIG, npages);
+  for(r = 0; r < NROUND; r++){
+    statsclear();
+    clock_gettime(&t0);
+    for(i = 0; i < NSMALL; i++){
+      setname(i);
+      readall(name);
+    }
+    clock_gettime(&t1);
+    n = statistics(report, sizeof(report) - 1);
+    report[n < 0 ? 0 : n] = 0;
+    readall("cb/big");
+    clock_gettime(&t2);
+    printf("  round %d: small files %d us, large file %d us\n",
+           r, (int)((t1 - t0) / 1000), (int)((t2 - t1) / 1000));
+    printline("bcache:");
+    printline("bcache.2q:");
+  }
+
+  for(i = 0; i < NSMALL; i++){
+    setname(i);
+    unlink(name);
+  }
+  unlink("cb/big");
+  unlink("cb");
+  exit(0);
+}
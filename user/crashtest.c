@@ -0,0 +1,171 @@
+//
+// check that the file system survives a crash mid-write.
+//
+// usage: crashtest write
+//        crashtest check n
+//
+// crashtest write makes files ct0, ct1, ... of known contents,
+// for ever, fsync()ing each and printing how many are synced.
+// grade-crash kills qemu while it runs, and after a reboot,
+// crashtest check n checks that the first n files are whole,
+// that any later ones hold what was written, as far as they
+// go, and that the file system still works; then it removes
+// the files.
+//
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define CHUNK   1000  // bytes per write, not a whole block
+#define NCHUNK  16    // writes per file
+#define NFILE   100   // files at most
+
+char buf[CHUNK];
+
+void
+name(char *s, int i)
+{
+  s[0] = 'c';
+  s[1] = 't';
+  s[2] = '0' + i / 100;
+  s[3] = '0' + i / 10 % 10;
+  s[4] = '0' + i % 10;
+  s[5] = '\0';
+}
+
+// what write() wrote at offset off of file i.
+char
+pattern(int i, int off)
+{
+  return 'a' + (i * 7 + off) % 26;
+}
+
+void
+fill(int i, int off)
+{
+  int k;
+
+  for(k = 0; k < CHUNK; k++)
+    buf[k] = pattern(i, off + k);
+}
+
+void
+writefiles(void)
+{
+  char path[8];
+  int i, j, fd;
+
+  // left over from a run that wasn't checked.
+  for(i = 0; i < NFILE; i++){
+    name(path, i);
+    unlink(path);
+  }
+  for(i = 0; i < NFILE; i++){
+    name(path, i);
+    if((fd = open(path, O_CREATE | O_WRONLY | O_TRUNC)) < 0){
+      fprintf(2, "crashtest: cannot create %s\n", path);
+      exit(1);
+    }
+    for(j = 0; j < NCHUNK; j++){
+      fill(i, j * CHUNK);
+      if(write(fd, buf, CHUNK) != CHUNK){
+        fprintf(2, "crashtest: write %s failed\n", path);
+        exit(1);
+      }
+    }
+    if(fsync(fd) < 0){
+      fprintf(2, "crashtest: fsync %s failed\n", path);
+      exit(1);
+    }
+    close(fd);
+    printf("crashtest: synced %d\n", i + 1);
+  }
+  // out of files before being killed; wait for it.
+  for(;;)
+    sleep(100);
+}
+
+// check file i; return its size, or -1 if it doesn't exist.
+int
+checkfile(int i)
+{
+  char path[8];
+  int fd, n, k, off;
+
+  name(path, i);
+  if((fd = open(path, O_RDONLY)) < 0)
+    return -1;
+  off = 0;
+  while((n = read(fd, buf, CHUNK)) > 0){
+    for(k = 0; k < n; k++){
+      if(buf[k] != pattern(i, off + k)){
+        printf("crashtest: %s: wrong byte at %d\n", path, off + k);
+        exit(1);
+      }
+    }
+    off += n;
+  }
+  close(fd);
+  if(n < 0 || off > CHUNK * NCHUNK){
+    printf("crashtest: %s: bad size %d\n", path, off);
+    exit(1);
+  }
+  return off;
+}
+
+void
+checkfiles(int nsynced)
+{
+  char path[8];
+  int i, n, fd;
+
+  for(i = 0; i < NFILE; i++){
+    n = checkfile(i);
+    if(i < nsynced && n != CHUNK * NCHUNK){
+      name(path, i);
+      printf("crashtest: %s synced, but %d bytes\n", path, n);
+      exit(1);
+    }
+    if(n < 0)
+      break;
+  }
+  // files are made one after another, so none follows a missing one.
+  for(; i < NFILE; i++){
+    if(checkfile(i) >= 0){
+      name(path, i);
+      printf("crashtest: %s after a missing file\n", path);
+      exit(1);
+    }
+  }
+
+  // the recovered file system takes new writes, and can
+  // free what it recovered.
+  fill(NFILE, 0);
+  if((fd = open("ctnew", O_CREATE | O_WRONLY)) < 0 ||
+     write(fd, buf, CHUNK) != CHUNK || fsync(fd) < 0){
+    printf("crashtest: cannot write ctnew\n");
+    exit(1);
+  }
+  close(fd);
+  unlink("ctnew");
+  for(i = 0; i < NFILE; i++){
+    name(path, i);
+    unlink(path);
+  }
+  printf("crashtest: ok\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  if(argc == 2 && strcmp(argv[1], "write") == 0)
+    writefiles();
+  else if(argc == 3 && strcmp(argv[1], "check") == 0)
+    checkfiles(atoi(argv[2]));
+  else {
+    fprintf(2, "usage: crashtest write | crashtest check n\n");
+    exit(1);
+  }
+  exit(0);
+}
@@ -0,0 +1,73 @@
+//
+// run a command with the kernel profiler on and print the
+// kernel samples on the console, for prof.py -k to symbolize.
+//
+// usage: kprof command [args...]
+//
+// each sample is printed as a line
+//   kprof: pc ra1 ra2 ...
+// with the innermost pc first.
+//
+
+#include "kernel/types.h"
+#include "kernel/riscv.h"
+#include "kernel/fcntl.h"
+#include "kernel/spinlock.h"
+#include "kernel/sleeplock.h"
+#include "kernel/fs.h"
+#include "kernel/file.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+
+struct profsample samples[16];
+
+int
+main(int argc, char *argv[])
+{
+  int fd, pid, n, i, j, total;
+
+  if(argc < 2){
+    fprintf(2, "usage: kprof command [args...]\n");
+    exit(1);
+  }
+
+  if((fd = open("kprof", O_RDWR)) < 0){
+    mknod("kprof", KPROF, 0);
+    fd = open("kprof", O_RDWR);
+  }
+  if(fd < 0){
+    fprintf(2, "kprof: cannot open kprof\n");
+    exit(1);
+  }
+
+  write(fd, "1", 1);
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "kprof: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fd);
+    exec(argv[1], &argv[1]);
+    fprintf(2, "kprof: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  write(fd, "0", 1);
+
+  printf("kprof: begin %s\n", argv[1]);
+  total = 0;
+  while((n = read(fd, samples, sizeof(samples))) > 0){
+    n /= sizeof(samples[0]);
+    for(i = 0; i < n; i++){
+      printf("kprof: %p", samples[i].pc[0]);
+      for(j = 1; j < PROFDEPTH && samples[i].pc[j]; j++)
+        printf(" %p", samples[i].pc[j]);
+      printf("\n");
+    }
+    total += n;
+  }
+  close(fd);
+  printf("kprof: end %d samples\n", total);
+  exit(0);
+}
@@ -0,0 +1,180 @@
+//
+// drive one heavily shared kernel lock from several processes
+// and report throughput, fairness and the lock's statistics,
+// to compare spinlock implementations (build with and without
+// TICKETLOCK=1, and with CPUS=n).
+//
+// usage: lockbench [nproc [ticks]]
+//
+// workloads:
+//   kmem    grow and shrink the heap: kalloc()/kfree().
+//   bcache  re-read a small file: bread()/brelse() on shared blocks.
+//   log     create and unlink files: begin_op()/end_op().
+//   inode   fstat one shared file: ilock()/iunlock(), a sleeplock
+//           held briefly, which acquiresleep() may spin on.
+//
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define MAXPROC 8
+#define NBLOCK  8    // blocks in the bcache workload's file
+
+char buf[512];
+char report[4096];
+
+int
+kmemop(int id)
+{
+  if(sbrk(16*4096) == (char*)-1)
+    return -1;
+  sbrk(-16*4096);
+  return 0;
+}
+
+int
+bcacheop(int id)
+{
+  int fd, i;
+
+  if((fd = open("lockbench.dat", O_RDONLY)) < 0)
+    return -1;
+  for(i = 0; i < NBLOCK; i++)
+    read(fd, buf, sizeof(buf));
+  close(fd);
+  return 0;
+}
+
+int
+logop(int id)
+{
+  char name[] = "lockbench.0";
+  int fd;
+
+  name[10] = '0' + id;
+  if((fd = open(name, O_CREATE | O_WRONLY)) < 0)
+    return -1;
+  close(fd);
+  return unlink(name);
+}
+
+int shared;          // fd of lockbench.dat, for the inode workload
+
+int
+inodeop(int id)
+{
+  struct stat st;
+
+  return fstat(shared, &st);
+}
+
+// print the report line for lock name.
+void
+printlock(char *name)
+{
+  char *p = report, *e;
+  int n = strlen(name);
+
+  while(*p){
+    for(e = p; *e && *e != '\n'; e++)
+      ;
+    if(memcmp(p, name, n) == 0 && p[n] == ' '){
+      write(1, "  ", 2);
+      write(1, p, e - p + 1);
+      return;
+    }
+    p = *e ? e + 1 : e;
+  }
+  printf("  %s: no contention recorded\n", name);
+}
+
+void
+bench(char *wname, char *lockname, int (*op)(int), int nproc, int ticks, int sleeplk)
+{
+  int i, n, start, end, fds[2], count[MAXPROC], min, max, total;
+
+  if(pipe(fds) < 0){
+    fprintf(2, "lockbench: pipe failed\n");
+    exit(1);
+  }
+  statsclear();
+  start = uptime() + 1;
+  end = start + ticks;
+  for(i = 0; i < nproc; i++){
+    if(fork() == 0){
+      close(fds[0]);
+      // start together, on a tick boundary.
+      while(uptime() < start)
+        ;
+      for(n = 0; uptime() < end; n++){
+        if(op(i) < 0){
+          fprintf(2, "lockbench: %s failed\n", wname);
+          n = -1;
+          break;
+        }
+      }
+      write(fds[1], &n, sizeof(n));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+  total = 0;
+  min = max = -1;
+  for(i = 0; i < nproc; i++){
+    if(read(fds[0], &count[i], sizeof(count[i])) != sizeof(count[i]))
+      count[i] = -1;
+    total += count[i];
+    if(min < 0 || count[i] < min)
+      min = count[i];
+    if(count[i] > max)
+      max = count[i];
+  }
+  close(fds[0]);
+  for(i = 0; i < nproc; i++)
+    wait(0);
+
+  n = statistics(report, sizeof(report) - 1);
+  report[n < 0 ? 0 : n] = 0;
+  printf("%s: %d procs, %d ops/tick, per-proc min %d max %d (fairness %d%%)\n",
+         wname, nproc, total / ticks, min, max, max > 0 ? min * 100 / max : 0);
+  printlock(lockname);
+  if(sleeplk)
+    printlock("sleeplocks:");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nproc = 4, ticks = 20, fd, i;
+
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(argc > 2)
+    ticks = atoi(argv[2]);
+  if(nproc < 1 || nproc > MAXPROC || ticks < 1){
+    fprintf(2, "usage: lockbench [nproc (1-%d) [ticks]]\n", MAXPROC);
+    exit(1);
+  }
+
+  if((fd = open("lockbench.dat", O_CREATE | O_WRONLY | O_TRUNC)) < 0){
+    fprintf(2, "lockbench: cannot create lockbench.dat\n");
+    exit(1);
+  }
+  for(i = 0; i < NBLOCK; i++)
+    write(fd, buf, sizeof(buf));
+  close(fd);
+
+  bench("kmem", "kmem", kmemop, nproc, ticks, 0);
+  bench("bcache", "bcache.bucket", bcacheop, nproc, ticks, 1);
+  bench("log", "log", logop, nproc, ticks, 0);
+  if((shared = open("lockbench.dat", O_RDONLY)) < 0){
+    fprintf(2, "lockbench: cannot open lockbench.dat\n");
+    exit(1);
+  }
+  bench("inode", "sleep lock", inodeop, nproc, ticks, 1);
+  close(shared);
+  unlink("lockbench.dat");
+  exit(0);
+}
@@ -1,12 +1,55 @@
 #include "kernel/types.h"
 #include "user/user.h"
 
+// pingpong: exchange one byte between parent and child over a pair of pipes.
+// pingpong n: time n such round trips.
+int roundtrips(int n)
+{
+  int p_to_c[2];
+  int c_to_p[2];
+  char b = 0;
+  int i, t0, t1;
+  pipe(p_to_c);
+  pipe(c_to_p);
+  if (fork() == 0)
+  {
+    close(p_to_c[1]);
+    close(c_to_p[0]);
+    while (read(p_to_c[0], &b, 1) == 1)
+      write(c_to_p[1], &b, 1);
+    exit(0);
+  }
+  close(p_to_c[0]);
+  close(c_to_p[1]);
+  t0 = uptime();
+  for (i = 0; i < n; i++)
+  {
+    write(p_to_c[1], &b, 1);
+    if (read(c_to_p[0], &b, 1) != 1)
+    {
+      printf("pong error! read failed\n");
+      return 1;
+    }
+  }
+  t1 = uptime();
+  close(p_to_c[1]);
+  close(c_to_p[0]);
+  wait(0);
+  printf("%d round trips in %d ticks", n, t1 - t0);
+  if (t1 > t0)
+    printf(", %d per tick", n / (t1 - t0));
+  printf("\n");
+  return 0;
+}
+
 int main(int argc, char *argv[])
 {
   int p_to_c[2];
   int c_to_p[2];
   char parent_buf = 0xae;
   char parent_result;
+  if (argc > 1)
+    return roundtrips(atoi(argv[1]));
   pipe(p_to_c);
   pipe(c_to_p);
   if (fork() == 0)
@@ -0,0 +1,64 @@
+//
+// run a command under the sampling profiler and print its
+// samples on the console, for prof.py to symbolize.
+//
+// usage: prof command [args...]
+//
+// each sample is printed as a line
+//   prof: pc ra1 ra2 ...
+// with the innermost pc first.
+//
+
+#include "kernel/types.h"
+#include "kernel/riscv.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+
+struct profsample samples[16];
+
+int
+main(int argc, char *argv[])
+{
+  int pid, n, i, j, total;
+
+  if(argc < 2){
+    fprintf(2, "usage: prof command [args...]\n");
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "prof: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    if(prof(PROF_START, 0, 0, 0) < 0){
+      fprintf(2, "prof: cannot start profiling\n");
+      exit(1);
+    }
+    exec(argv[1], &argv[1]);
+    fprintf(2, "prof: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+
+  // drain samples until the child has exited and
+  // its buffer is empty; only then reap it.
+  printf("prof: begin %s\n", argv[1]);
+  total = 0;
+  while((n = prof(PROF_READ, pid, samples, sizeof(samples)/sizeof(samples[0]))) >= 0){
+    if(n == 0){
+      sleep(1);
+      continue;
+    }
+    for(i = 0; i < n; i++){
+      printf("prof: %p", samples[i].pc[0]);
+      for(j = 1; j < PROFDEPTH && samples[i].pc[j]; j++)
+        printf(" %p", samples[i].pc[j]);
+      printf("\n");
+    }
+    total += n;
+  }
+  wait(0);
+  printf("prof: end %d samples\n", total);
+  exit(0);
+}
@@ -0,0 +1,105 @@
+//
+// measure sequential read throughput from a cold buffer cache.
+//
+// usage: readbench [bufsize]
+//
+// writes a file, pushes it out of the buffer cache by using up
+// free memory (kalloc() takes the cache's pages back), and
+// reads it through bufsize bytes at a time (default 512, like
+// cat), reporting the rate and the buffer cache's hit rate.
+//
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "user/user.h"
+
+#define NBLOCK  (MAXFILE - 8)  // blocks in the file
+#define MAXBUF  (8*BSIZE)
+
+char buf[MAXBUF];
+char report[4096];
+
+// grow the heap until memory runs out, then give it back.
+void
+dropcache(void)
+{
+  int n = 0;
+
+  while(sbrk(64*4096) != (char*)-1)
+    n++;
+  sbrk(-n*64*4096);
+}
+
+// print the report line starting with name.
+void
+printline(char *name)
+{
+  char *p = report, *e;
+  int n = strlen(name);
+
+  while(*p){
+    for(e = p; *e && *e != '\n'; e++)
+      ;
+    if(memcmp(p, name, n) == 0){
+      write(1, "  ", 2);
+      write(1, p, e - p + 1);
+      return;
+    }
+    p = *e ? e + 1 : e;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd, i, n, bufsize = 512;
+  uint64 t0, t1, total;
+
+  if(argc > 1)
+    bufsize = atoi(argv[1]);
+  if(bufsize < 1 || bufsize > MAXBUF){
+    fprintf(2, "usage: readbench [bufsize (1-%d)]\n", MAXBUF);
+    exit(1);
+  }
+
+  if((fd = open("readbench.dat", O_CREATE | O_WRONLY | O_TRUNC)) < 0){
+    fprintf(2, "readbench: cannot create readbench.dat\n");
+    exit(1);
+  }
+  memset(buf, 'r', BSIZE);
+  for(i = 0; i < NBLOCK; i++){
+    if(write(fd, buf, BSIZE) != BSIZE){
+      fprintf(2, "readbench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+
+  dropcache();
+  statsclear();
+
+  if((fd = open("readbench.dat", O_RDONLY)) < 0){
+    fprintf(2, "readbench: cannot open readbench.dat\n");
+    exit(1);
+  }
+  total = 0;
+  clock_gettime(&t0);
+  while((n = read(fd, buf, bufsize)) > 0)
+    total += n;
+  clock_gettime(&t1);
+  close(fd);
+  unlink("readbench.dat");
+
+  if(total != NBLOCK * BSIZE){
+    fprintf(2, "readbench: read %d bytes, want %d\n", (int)total, NBLOCK * BSIZE);
+    exit(1);
+  }
+  n = statistics(report, sizeof(report) - 1);
+  report[n < 0 ? 0 : n] = 0;
+  printf("readbench: %d KB in %d-byte reads: %d us, %d KB/s\n",
+         (int)(total / 1024), bufsize, (int)((t1 - t0) / 1000),
+         t1 > t0 ? (int)(total * 1000000000 / 1024 / (t1 - t0)) : 0);
+  printline("bcache:");
+  exit(0);
+}
@@ -0,0 +1,127 @@
+//
+// compare small-I/O throughput of direct system calls with
+// batches submitted through the shared syscall ring.
+//
+// usage: ringbench [n]
+//
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/ioring.h"
+#include "user/user.h"
+
+#define SMALL  16   // bytes per read or write
+#define BATCH  32   // submissions per ringenter()
+
+char buf[SMALL];
+struct stat st;
+struct ioring *ring;
+
+// queue one submission; the ring must have room.
+void
+submit(int op, int fd, void *addr, int len)
+{
+  struct iosqe *sqe = &ring->sq[ring->sqtail % IORING_NSQE];
+
+  sqe->op = op;
+  sqe->fd = fd;
+  sqe->addr = (uint64)addr;
+  sqe->len = len;
+  sqe->flags = 0;
+  sqe->user_data = ring->sqtail;
+  ring->sqtail++;
+}
+
+// carry out everything queued and check the completions.
+void
+flush(int want)
+{
+  int n = ring->sqtail - ring->sqhead;
+
+  if(ringenter(n) != n){
+    fprintf(2, "ringbench: ringenter failed\n");
+    exit(1);
+  }
+  while(ring->cqhead != ring->cqtail){
+    if(ring->cq[ring->cqhead % IORING_NCQE].res != want){
+      fprintf(2, "ringbench: op failed\n");
+      exit(1);
+    }
+    ring->cqhead++;
+  }
+}
+
+// run op n times directly or through the ring,
+// and return the elapsed ticks.
+int
+run(int op, int fd, int n, int usering)
+{
+  int i, t0, want;
+
+  want = op == IORING_OP_FSTAT ? 0 : SMALL;
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if(usering){
+      submit(op, fd, op == IORING_OP_FSTAT ? (void*)&st : buf, SMALL);
+      if(ring->sqtail - ring->sqhead == BATCH)
+        flush(want);
+      continue;
+    }
+    int r;
+    if(op == IORING_OP_READ)
+      r = read(fd, buf, SMALL);
+    else if(op == IORING_OP_WRITE)
+      r = write(fd, buf, SMALL);
+    else
+      r = fstat(fd, &st);
+    if(r != want){
+      fprintf(2, "ringbench: op failed\n");
+      exit(1);
+    }
+  }
+  if(usering)
+    flush(want);
+  return uptime() - t0;
+}
+
+void
+bench(char *name, int op, int n)
+{
+  int fd, t[2];
+
+  for(int usering = 0; usering < 2; usering++){
+    if(op == IORING_OP_WRITE){
+      fd = open("ringbench.tmp", O_CREATE | O_TRUNC | O_WRONLY);
+    } else {
+      fd = open("ringbench.tmp", O_RDONLY);
+    }
+    if(fd < 0){
+      fprintf(2, "ringbench: open failed\n");
+      exit(1);
+    }
+    t[usering] = run(op, fd, n, usering);
+    close(fd);
+  }
+  printf("%s x %d: direct %d ticks, ring %d ticks\n", name, n, t[0], t[1]);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n = 2000;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if((ring = ringsetup()) == (struct ioring*)-1){
+    fprintf(2, "ringbench: ringsetup failed\n");
+    exit(1);
+  }
+  memset(buf, 'r', sizeof(buf));
+
+  bench("write", IORING_OP_WRITE, n);
+  bench("read", IORING_OP_READ, n);
+  bench("fstat", IORING_OP_FSTAT, n);
+  unlink("ringbench.tmp");
+  exit(0);
+}
@@ -0,0 +1,125 @@
+//
+// measure deadline misses of a periodic task running
+// against background load from grind.
+//
+// usage: rtbench [-r] [nload]
+//   -r     run the task in the real-time (EDF) class.
+//   nload  number of grind instances to start (default 2).
+//
+// every PERIOD ticks the task releases a job worth about
+// WORK ticks of computation, due by the start of the next
+// period.  a job that finishes late is a deadline miss.
+//
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define PERIOD  4   // ticks between job releases
+#define BUDGET  2   // ticks of CPU reserved per period
+#define WORK    1   // ticks of computation per job
+#define NJOB    50
+
+volatile int sink;
+
+void
+spin(int n)
+{
+  for(int i = 0; i < n; i++)
+    sink += i;
+}
+
+// how many spin() iterations fit in one tick on an idle machine?
+int
+calibrate(void)
+{
+  int t0, n;
+
+  t0 = uptime();
+  while(uptime() == t0)
+    ;
+  t0 = uptime();
+  for(n = 0; uptime() == t0; n += 1000)
+    spin(1000);
+  return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rt = 0, nload = 2;
+  int i, pid, firstpid, lastpid;
+  int work, release, deadline, now, misses, worst;
+
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-r") == 0)
+      rt = 1;
+    else
+      nload = atoi(argv[i]);
+  }
+
+  work = calibrate() * WORK;
+
+  firstpid = 0;
+  for(i = 0; i < nload; i++){
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "rtbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      char *argv[] = { "grind", 0 };
+      close(1);
+      close(2);
+      exec("grind", argv);
+      exit(1);
+    }
+    if(firstpid == 0)
+      firstpid = pid;
+  }
+
+  // let the load get going.
+  sleep(5);
+
+  if(rt && rtsched(PERIOD, BUDGET) < 0){
+    fprintf(2, "rtbench: rtsched(%d, %d) not admitted\n", PERIOD, BUDGET);
+    exit(1);
+  }
+
+  misses = 0;
+  worst = 0;
+  release = uptime();
+  for(i = 0; i < NJOB; i++){
+    deadline = release + PERIOD;
+    spin(work);
+    now = uptime();
+    if(now > deadline){
+      misses++;
+      if(now - deadline > worst)
+        worst = now - deadline;
+    }
+    // wait for the next release; a late job starts at once.
+    release = deadline;
+    if((now = uptime()) < release)
+      sleep(release - now);
+    else
+      release = now;
+  }
+
+  if(rt)
+    rtsched(0, 0);
+
+  // grind leaves grandchildren behind; kill every process
+  // created since the load started.
+  if((lastpid = fork()) == 0)
+    exit(0);
+  wait(0);
+  for(pid = firstpid; pid < lastpid; pid++)
+    kill(pid);
+  for(i = 0; i < nload; i++)
+    wait(0);
+
+  printf("rtbench: %s, %d grind, period %d work %d: %d/%d deadlines missed, worst %d ticks late\n",
+         rt ? "edf" : "round-robin", nload, PERIOD, WORK, misses, NJOB, worst);
+  exit(0);
+}
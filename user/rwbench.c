@@ -0,0 +1,102 @@
+//
+// multi-hart microbenchmark for read-mostly kernel paths:
+// reading ticks (a seqlock) and looking up cached inodes
+// (the inode table's reader-writer lock).
+//
+// usage: rwbench [nproc [ticks]]
+//
+// each workload runs first in one process, then in nproc
+// processes at once; with more CPUS, the total rate should
+// grow rather than collapse onto one lock.
+//
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+int
+uptimeop(void)
+{
+  // the system call, not the USYSCALL page.
+  return trapuptime();
+}
+
+int
+lookupop(void)
+{
+  int fd;
+
+  if((fd = open("README", O_RDONLY)) < 0)
+    return -1;
+  close(fd);
+  return 0;
+}
+
+// run op in n processes for ticks ticks;
+// returns the total number of ops.
+int
+run(int (*op)(void), int n, int ticks)
+{
+  int i, c, total, start, end, fds[2];
+
+  if(pipe(fds) < 0){
+    fprintf(2, "rwbench: pipe failed\n");
+    exit(1);
+  }
+  start = uptime() + 1;
+  end = start + ticks;
+  for(i = 0; i < n; i++){
+    if(fork() == 0){
+      close(fds[0]);
+      while(uptime() < start)
+        ;
+      for(c = 0; uptime() < end; c++){
+        if(op() < 0){
+          fprintf(2, "rwbench: op failed\n");
+          exit(1);
+        }
+      }
+      write(fds[1], &c, sizeof(c));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+  total = 0;
+  for(i = 0; i < n; i++){
+    if(read(fds[0], &c, sizeof(c)) == sizeof(c))
+      total += c;
+  }
+  close(fds[0]);
+  for(i = 0; i < n; i++)
+    wait(0);
+  return total;
+}
+
+void
+bench(char *name, int (*op)(void), int nproc, int ticks)
+{
+  int one, all;
+
+  one = run(op, 1, ticks);
+  all = run(op, nproc, ticks);
+  printf("%s: 1 proc %d ops/tick, %d procs %d ops/tick\n",
+         name, one / ticks, nproc, all / ticks);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nproc = 4, ticks = 10;
+
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(argc > 2)
+    ticks = atoi(argv[2]);
+  if(nproc < 1 || ticks < 1){
+    fprintf(2, "usage: rwbench [nproc [ticks]]\n");
+    exit(1);
+  }
+  bench("uptime", uptimeop, nproc, ticks);
+  bench("inode lookup", lookupop, nproc, ticks);
+  exit(0);
+}
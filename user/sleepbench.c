@@ -0,0 +1,51 @@
+//
+// measure how long nanosleep() and sleep() really sleep.
+//
+// usage: sleepbench [n]
+//
+// for each requested duration, sleep n times and report the
+// mean time actually slept, from clock_gettime().
+//
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define US 1000ULL  // nanoseconds per microsecond
+
+// sleep for ns nanoseconds n times with nanosleep(),
+// or for one tick with sleep() if ns is 0.
+// returns the mean time slept, in microseconds.
+int
+measure(uint64 ns, int n)
+{
+  uint64 t0, t1;
+  int i;
+
+  clock_gettime(&t0);
+  for(i = 0; i < n; i++){
+    if(ns == 0)
+      sleep(1);
+    else if(nanosleep(ns) < 0){
+      fprintf(2, "sleepbench: nanosleep failed\n");
+      exit(1);
+    }
+  }
+  clock_gettime(&t1);
+  return (t1 - t0) / n / US;
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 durations[] = { 50*US, 200*US, 1000*US, 5000*US, 20000*US };
+  int i, n = 20;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+
+  for(i = 0; i < sizeof(durations)/sizeof(durations[0]); i++)
+    printf("nanosleep(%d us) x %d: %d us each\n", (int)(durations[i] / US), n,
+           measure(durations[i], n));
+  printf("sleep(1) x %d: %d us each\n", n, measure(0, n));
+  exit(0);
+}
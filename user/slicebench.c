@@ -0,0 +1,126 @@
+//
+// measure context-switch rate and throughput of CPU-bound
+// work, alone and next to grind, to tune time slices
+// (QMIN and QMAX in kernel/param.h).
+//
+// usage: slicebench [ticks]
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+#define NCOMPUTE 3   // compute loops
+#define NGRIND   2   // grind instances in the mixed run
+
+volatile struct usyscall *u = (struct usyscall *)USYSCALL;
+volatile int sink;
+
+struct result {
+  int kiters;        // thousands of loop iterations
+  uint nivcsw;
+  uint nvcsw;
+};
+
+// spin until tick end, then report on fd.
+void
+compute(int end, int fd)
+{
+  struct result r;
+  int i;
+
+  r.kiters = 0;
+  while(uptime() < end){
+    for(i = 0; i < 1000; i++)
+      sink += i;
+    r.kiters++;
+  }
+  r.nivcsw = u->nivcsw;
+  r.nvcsw = u->nvcsw;
+  write(fd, &r, sizeof(r));
+  exit(0);
+}
+
+void
+run(char *name, int ticks, int ngrind)
+{
+  int i, pid, firstpid, lastpid, end, start, fds[2];
+  uint nswitch;
+  struct result r, sum;
+
+  if(pipe(fds) < 0){
+    fprintf(2, "slicebench: pipe failed\n");
+    exit(1);
+  }
+
+  firstpid = 0;
+  for(i = 0; i < ngrind; i++){
+    if((pid = fork()) == 0){
+      char *argv[] = { "grind", 0 };
+      close(1);
+      close(2);
+      exec("grind", argv);
+      exit(1);
+    }
+    if(firstpid == 0)
+      firstpid = pid;
+  }
+
+  start = uptime();
+  end = start + ticks;
+  nswitch = u->nswitch;
+  for(i = 0; i < NCOMPUTE; i++){
+    if(fork() == 0){
+      close(fds[0]);
+      compute(end, fds[1]);
+    }
+  }
+  close(fds[1]);
+  memset(&sum, 0, sizeof(sum));
+  for(i = 0; i < NCOMPUTE; i++){
+    if(read(fds[0], &r, sizeof(r)) != sizeof(r)){
+      fprintf(2, "slicebench: short read\n");
+      exit(1);
+    }
+    sum.kiters += r.kiters;
+    sum.nivcsw += r.nivcsw;
+    sum.nvcsw += r.nvcsw;
+  }
+  close(fds[0]);
+  nswitch = u->nswitch - nswitch;
+
+  // grind leaves grandchildren behind; kill every process
+  // created since the load started.
+  if(ngrind > 0){
+    if((lastpid = fork()) == 0)
+      exit(0);
+    wait(0);
+    for(pid = firstpid; pid < lastpid; pid++)
+      kill(pid);
+  }
+  for(i = 0; i < NCOMPUTE + ngrind; i++)
+    wait(0);
+
+  printf("%s: %d ticks, %d kiters/tick, %d switches/s overall, compute loops preempted %d yielded %d\n",
+         name, ticks, sum.kiters / ticks, nswitch * (TIMEFREQ / TICKINTERVAL) / ticks,
+         sum.nivcsw, sum.nvcsw);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ticks = 50;
+
+  if(argc > 1)
+    ticks = atoi(argv[1]);
+  if(ticks <= 0){
+    fprintf(2, "usage: slicebench [ticks]\n");
+    exit(1);
+  }
+  printf("slicebench: quanta are from %d to %d ticks\n", QMIN, QMAX);
+  run("compute", ticks, 0);
+  run("compute+grind", ticks, NGRIND);
+  exit(0);
+}
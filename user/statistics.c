@@ -0,0 +1,48 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/spinlock.h"
+#include "kernel/sleeplock.h"
+#include "kernel/fs.h"
+#include "kernel/file.h"
+#include "user/user.h"
+
+// read the kernel's lock statistics report into buf, which
+// holds sz bytes. returns the number of bytes read.
+int
+statistics(void *buf, int sz)
+{
+  int fd, i, n;
+
+  if((fd = open("statistics", O_RDONLY)) < 0){
+    mknod("statistics", STATS, 0);
+    fd = open("statistics", O_RDONLY);
+  }
+  if(fd < 0){
+    fprintf(2, "statistics: open failed\n");
+    return -1;
+  }
+  for(i = 0; i < sz; i += n){
+    if((n = read(fd, (char*)buf + i, sz - i)) <= 0)
+      break;
+  }
+  close(fd);
+  return i;
+}
+
+// zero the kernel's lock statistics.
+int
+statsclear(void)
+{
+  int fd;
+
+  if((fd = open("statistics", O_WRONLY)) < 0){
+    mknod("statistics", STATS, 0);
+    fd = open("statistics", O_WRONLY);
+  }
+  if(fd < 0)
+    return -1;
+  write(fd, "0", 1);
+  close(fd);
+  return 0;
+}
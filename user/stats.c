@@ -0,0 +1,43 @@
+//
+// print the most contended kernel locks.
+//
+// usage: stats [-z] [command [args...]]
+//   -z       zero the statistics first.
+//   command  run it and report only the locking it caused.
+//
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define SZ 4096
+char buf[SZ];
+
+int
+main(int argc, char *argv[])
+{
+  int n, i = 1;
+
+  if(argc > 1 && strcmp(argv[1], "-z") == 0){
+    statsclear();
+    i++;
+  }
+  if(i < argc){
+    statsclear();
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "stats: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[i], &argv[i]);
+      fprintf(2, "stats: exec %s failed\n", argv[i]);
+      exit(1);
+    }
+    wait(0);
+  }
+  if((n = statistics(buf, SZ - 1)) < 0)
+    exit(1);
+  buf[n] = 0;
+  printf("%s", buf);
+  exit(0);
+}
@@ -9,18 +9,24 @@
 
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
 #include "user/user.h"
 #include "kernel/fs.h"
 #include "kernel/fcntl.h"
 
+volatile struct usyscall *u = (struct usyscall *)USYSCALL;
+
 int
 main(int argc, char *argv[])
 {
-  int fd, i;
+  int fd, i, me;
+  uint nswitch;
   char path[] = "stressfs0";
   char data[512];
 
   printf("stressfs starting\n");
+  nswitch = u->nswitch;
   memset(data, 'a', sizeof(data));
 
   for(i = 0; i < 4; i++)
@@ -28,6 +34,7 @@ main(int argc, char *argv[])
       break;
 
   printf("write %d\n", i);
+  me = i;
 
   path[8] += i;
   fd = open(path, O_CREATE | O_RDWR);
@@ -45,5 +52,10 @@ main(int argc, char *argv[])
 
   wait(0);
 
+  // each process waits for the next one it forked,
+  // so the first finishes last.
+  if(me == 0)
+    printf("stressfs: %d context switches\n", u->nswitch - nswitch);
+
   exit(0);
 }
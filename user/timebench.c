@@ -0,0 +1,67 @@
+//
+// time tight loops of getpid(), uptime() and clock reads,
+// through the USYSCALL page and through system calls.
+//
+// usage: timebench [n]
+//
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+volatile uint64 sink;
+
+// nanoseconds per iteration of n iterations that took dt
+// time CSR units.
+int
+nsper(uint64 dt, int n)
+{
+  return dt * (1000000000 / timefreq()) / n;
+}
+
+void
+report(char *name, uint64 dt, int n)
+{
+  printf("%s: %d ns/call\n", name, nsper(dt, n));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n = 100000;
+  uint64 t0;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+
+  t0 = rdtime();
+  for(i = 0; i < n; i++)
+    sink += getpid();
+  report("getpid (usyscall page)", rdtime() - t0, n);
+
+  t0 = rdtime();
+  for(i = 0; i < n; i++)
+    sink += trapgetpid();
+  report("getpid (system call)  ", rdtime() - t0, n);
+
+  t0 = rdtime();
+  for(i = 0; i < n; i++)
+    sink += uptime();
+  report("uptime (usyscall page)", rdtime() - t0, n);
+
+  t0 = rdtime();
+  for(i = 0; i < n; i++)
+    sink += trapuptime();
+  report("uptime (system call)  ", rdtime() - t0, n);
+
+  t0 = rdtime();
+  for(i = 0; i < n; i++)
+    sink += rdtime();
+  report("rdtime                ", rdtime() - t0, n);
+
+  if(getpid() != trapgetpid() || uptime() - trapuptime() > 1){
+    fprintf(2, "timebench: usyscall page disagrees with the kernel\n");
+    exit(1);
+  }
+  exit(0);
+}
@@ -0,0 +1,142 @@
+//
+// run a command with system call tracing, or show the
+// kernel's system call latency histograms.
+//
+// usage: trace mask command [args...]
+//          log the calls whose bits are set in mask, then
+//          show latencies of the calls made while it ran.
+//        trace -h
+//          show latencies of every call since boot.
+//
+// times are in cycles of the time CSR.
+//
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/syscall.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+char *names[NSYSCALL] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_rtsched] "rtsched",
+[SYS_ringsetup] "ringsetup",
+[SYS_ringenter] "ringenter",
+[SYS_trace]   "trace",
+[SYS_traceread] "traceread",
+[SYS_syshist] "syshist",
+[SYS_prof]    "prof",
+[SYS_clock_gettime] "clock_gettime",
+[SYS_nanosleep] "nanosleep",
+[SYS_fsync]   "fsync",
+};
+
+uint before[NSYSCALL][NHISTBUCKET];
+uint after[NSYSCALL][NHISTBUCKET];
+struct tracerec recs[32];
+
+char*
+name(int num)
+{
+  if(num >= 0 && num < NSYSCALL && names[num])
+    return names[num];
+  return "?";
+}
+
+// print the records the kernel has logged so far.
+void
+dumprecs(void)
+{
+  int i, n;
+  struct tracerec *r;
+
+  while((n = traceread(recs, sizeof(recs)/sizeof(recs[0]))) > 0){
+    for(i = 0; i < n; i++){
+      r = &recs[i];
+      printf("%d: %s(%d, %d, %d) = %d, %d cycles\n", r->pid, name(r->num),
+             (int)r->args[0], (int)r->args[1], (int)r->args[2],
+             (int)r->ret, (int)r->cycles);
+    }
+  }
+}
+
+// print one line per system call with the non-empty buckets of
+// after - before, each labelled with the bucket's upper bound.
+void
+dumphist(void)
+{
+  int num, b, total;
+
+  for(num = 0; num < NSYSCALL; num++){
+    total = 0;
+    for(b = 0; b < NHISTBUCKET; b++)
+      total += after[num][b] - before[num][b];
+    if(total == 0)
+      continue;
+    printf("%s: %d calls,", name(num), total);
+    for(b = 0; b < NHISTBUCKET; b++){
+      if(after[num][b] == before[num][b])
+        continue;
+      if(b == NHISTBUCKET-1)
+        printf(" >=2^%d:%d", b, after[num][b] - before[num][b]);
+      else
+        printf(" <2^%d:%d", b+1, after[num][b] - before[num][b]);
+    }
+    printf("\n");
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid;
+
+  if(argc == 2 && strcmp(argv[1], "-h") == 0){
+    syshist((uint*)after);
+    dumphist();
+    exit(0);
+  }
+  if(argc < 3 || (argv[1][0] < '0' || argv[1][0] > '9')){
+    fprintf(2, "usage: trace mask command [args...] | trace -h\n");
+    exit(1);
+  }
+
+  syshist((uint*)before);
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "trace: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    trace(atoi(argv[1]));
+    exec(argv[2], &argv[2]);
+    fprintf(2, "trace: exec %s failed\n", argv[2]);
+    exit(1);
+  }
+  wait(0);
+  syshist((uint*)after);
+
+  dumprecs();
+  dumphist();
+  exit(0);
+}
@@ -1,4 +1,6 @@
 struct stat;
+struct ioring;
+struct tracerec;
 
 #define stdin 0
 #define stdout 1
@@ -22,10 +24,20 @@ int link(const char *, const char *);
 int mkdir(const char *);
 int chdir(const char *);
 int dup(int);
-int getpid(void);
+int trapgetpid(void);
 char *sbrk(int);
 int sleep(int);
-int uptime(void);
+int trapuptime(void);
+int rtsched(int, int);
+struct ioring *ringsetup(void);
+int ringenter(int);
+int trace(uint64);
+int traceread(struct tracerec*, int);
+int syshist(uint*);
+int prof(int, int, void*, int);
+int clock_gettime(uint64*);
+int nanosleep(uint64);
+int fsync(int);
 
 // ulib.c
 int stat(const char *, struct stat *);
@@ -44,3 +56,11 @@ void free(void *);
 int atoi(const char *);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+int getpid(void);
+int uptime(void);
+uint64 rdtime(void);
+uint64 timefreq(void);
+
+// statistics.c
+int statistics(void*, int);
+int statsclear(void);
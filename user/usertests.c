@@ -7,6 +7,7 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/ioring.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -2571,6 +2572,198 @@ badarg(char *s)
   exit(0);
 }
 
+// real-time admission control: bad parameters and
+// over-subscription are refused, and an exiting real-time
+// process gives its reservation back.
+void
+rtadmit(char *s)
+{
+  int pid, xstatus;
+
+  if(rtsched(-1, 1) == 0 || rtsched(4, 0) == 0 || rtsched(4, 5) == 0){
+    printf("%s: rtsched accepted bad parameters\n", s);
+    exit(1);
+  }
+  if(rtsched(10, 6) != 0){
+    printf("%s: rtsched(10, 6) refused\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    // the parent holds 60%, so 50% more must be refused.
+    if(rtsched(10, 5) == 0)
+      exit(1);
+    if(rtsched(10, 4) != 0)
+      exit(1);
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: child admission wrong\n", s);
+    exit(1);
+  }
+  if(rtsched(0, 0) != 0 || rtsched(1, 1) != 0 || rtsched(0, 0) != 0){
+    printf("%s: reservation not released\n", s);
+    exit(1);
+  }
+}
+
+// open, write, fstat, and close through the syscall ring,
+// in one batch, and read the data back the same way.
+void
+ringops(char *s)
+{
+  struct ioring *r;
+  struct stat st;
+  char data[8];
+  int i;
+  struct iosqe ops[] = {
+    { IORING_OP_OPEN, 0, (uint64)"ringops", 0, O_CREATE|O_RDWR, 1 },
+    { IORING_OP_WRITE, 3, (uint64)"ringops", 7, 0, 2 },
+    { IORING_OP_FSTAT, 3, (uint64)&st, 0, 0, 3 },
+    { IORING_OP_CLOSE, 3, 0, 0, 0, 4 },
+    { IORING_OP_OPEN, 0, (uint64)"ringops", 0, O_RDONLY, 5 },
+    { IORING_OP_READ, 3, (uint64)data, sizeof(data), 0, 6 },
+    { IORING_OP_CLOSE, 3, 0, 0, 0, 7 },
+    { IORING_OP_CLOSE, 3, 0, 0, 0, 8 },
+  };
+  int want[] = { 3, 7, 0, 0, 3, 7, 0, -1 };
+  int nops = sizeof(ops) / sizeof(ops[0]);
+
+  // the ring opens fd 3, so make sure it is the lowest free one.
+  for(i = 3; i < NOFILE; i++)
+    close(i);
+  if((r = ringsetup()) == (struct ioring*)-1 || ringsetup() != r){
+    printf("%s: ringsetup failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < nops; i++)
+    r->sq[r->sqtail++ % IORING_NSQE] = ops[i];
+  if(ringenter(nops) != nops || r->cqtail - r->cqhead != nops){
+    printf("%s: ringenter failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < nops; i++, r->cqhead++){
+    struct iocqe *cqe = &r->cq[r->cqhead % IORING_NCQE];
+    if(cqe->user_data != i + 1 || cqe->res != want[i]){
+      printf("%s: op %d returned %d\n", s, i, cqe->res);
+      exit(1);
+    }
+  }
+  if(st.size != 7 || memcmp(data, "ringops", 7) != 0){
+    printf("%s: wrong data\n", s);
+    exit(1);
+  }
+  if(ringenter(1) != 0){
+    printf("%s: empty ringenter\n", s);
+    exit(1);
+  }
+  unlink("ringops");
+}
+
+// write a big file with memory all used up, so that the
+// buffer cache can't grow to hold the blocks the log pins.
+void
+lowmemwrite(char *s)
+{
+  enum { SZ = 256*1024 };
+  char *buf;
+  int got, fd, i;
+
+  buf = sbrk(SZ);
+  if(buf == (char*)0xffffffffffffffffL){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < SZ; i++)
+    buf[i] = i % 251;
+
+  // take every page there is, some of them from the cache.
+  got = 0;
+  for(i = 1024*1024; i >= PGSIZE; i /= 2){
+    while(sbrk(i) != (char*)0xffffffffffffffffL)
+      got += i;
+  }
+
+  fd = open("lowmemwrite", O_CREATE|O_RDWR|O_TRUNC);
+  if(fd < 0){
+    sbrk(-got);
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  if(write(fd, buf, SZ) != SZ){
+    sbrk(-got);
+    printf("%s: write failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  sbrk(-got);
+
+  memset(buf, 0, SZ);
+  fd = open("lowmemwrite", O_RDONLY);
+  if(fd < 0 || read(fd, buf, SZ) != SZ){
+    printf("%s: read failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  for(i = 0; i < SZ; i++){
+    if(buf[i] != (char)(i % 251)){
+      printf("%s: wrong byte %d\n", s, i);
+      exit(1);
+    }
+  }
+  unlink("lowmemwrite");
+}
+
+// many small writes, grouped into a few commits, then fsync().
+void
+fsyncops(char *s)
+{
+  char buf[10];
+  int fd, i;
+
+  if(fsync(-1) >= 0 || fsync(NOFILE) >= 0){
+    printf("%s: fsync of a bad fd succeeded\n", s);
+    exit(1);
+  }
+  if((fd = open("fsyncops", O_CREATE|O_RDWR)) < 0){
+    printf("%s: open failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 200; i++){
+    if(write(fd, "0123456789", 10) != 10){
+      printf("%s: write %d failed\n", s, i);
+      exit(1);
+    }
+  }
+  if(fsync(fd) != 0 || fsync(fd) != 0){
+    printf("%s: fsync failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(fsync(fd) >= 0){
+    printf("%s: fsync of a closed fd succeeded\n", s);
+    exit(1);
+  }
+
+  if((fd = open("fsyncops", O_RDONLY)) < 0){
+    printf("%s: reopen failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 200; i++){
+    if(read(fd, buf, 10) != 10 || memcmp(buf, "0123456789", 10) != 0){
+      printf("%s: read %d wrong\n", s, i);
+      exit(1);
+    }
+  }
+  close(fd);
+  unlink("fsyncops");
+}
+
 struct test {
   void (*f)(char *);
   char *s;
@@ -2635,6 +2828,10 @@ struct test {
   {sbrklast, "sbrklast"},
   {sbrk8000, "sbrk8000"},
   {badarg, "badarg" },
+  {rtadmit, "rtadmit" },
+  {ringops, "ringops" },
+  {fsyncops, "fsyncops" },
+  {lowmemwrite, "lowmemwrite" },
 
   { 0, 0},
 };
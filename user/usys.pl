@@ -6,10 +6,12 @@ print "# generated by usys.pl - do not edit\n";
 
 print "#include \"kernel/syscall.h\"\n";
 
+# entry("name", "sym") makes sym the stub for system call name.
 sub entry {
     my $name = shift;
-    print ".global $name\n";
-    print "${name}:\n";
+    my $sym = shift || $name;
+    print ".global $sym\n";
+    print "${sym}:\n";
     print " li a7, SYS_${name}\n";
     print " ecall\n";
     print " ret\n";
@@ -32,7 +34,18 @@ entry("link");
 entry("mkdir");
 entry("chdir");
 entry("dup");
-entry("getpid");
+# ulib.c reads getpid() and uptime() from the USYSCALL page.
+entry("getpid", "trapgetpid");
 entry("sbrk");
 entry("sleep");
-entry("uptime");
+entry("uptime", "trapuptime");
+entry("rtsched");
+entry("ringsetup");
+entry("ringenter");
+entry("trace");
+entry("traceread");
+entry("syshist");
+entry("prof");
+entry("clock_gettime");
+entry("nanosleep");
+entry("fsync");
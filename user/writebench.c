@@ -0,0 +1,68 @@
+//
+// measure small-write throughput, with and without fsync().
+//
+// usage: writebench [n [size]]
+//
+// makes n writes of size bytes (default 1000 of 64) to a file,
+// first plain, then with an fsync() after each, and reports
+// writes per second for each.
+//
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define MAXSIZE 1024
+
+char buf[MAXSIZE];
+
+void
+run(int n, int size, int sync)
+{
+  int fd, i;
+  uint64 t0, t1;
+
+  if((fd = open("writebench.dat", O_CREATE | O_WRONLY | O_TRUNC)) < 0){
+    fprintf(2, "writebench: cannot create writebench.dat\n");
+    exit(1);
+  }
+  clock_gettime(&t0);
+  for(i = 0; i < n; i++){
+    if(write(fd, buf, size) != size){
+      fprintf(2, "writebench: write failed\n");
+      exit(1);
+    }
+    if(sync && fsync(fd) < 0){
+      fprintf(2, "writebench: fsync failed\n");
+      exit(1);
+    }
+  }
+  // count the time to make the writes durable.
+  fsync(fd);
+  clock_gettime(&t1);
+  close(fd);
+  unlink("writebench.dat");
+
+  printf("writebench: %d %d-byte writes%s: %d us, %d writes/s\n",
+         n, size, sync ? ", fsync each" : "", (int)((t1 - t0) / 1000),
+         t1 > t0 ? (int)((uint64)n * 1000000000 / (t1 - t0)) : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n = 1000, size = 64;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(argc > 2)
+    size = atoi(argv[2]);
+  if(n < 1 || size < 1 || size > MAXSIZE){
+    fprintf(2, "usage: writebench [n [size (1-%d)]]\n", MAXSIZE);
+    exit(1);
+  }
+  memset(buf, 'w', size);
+  run(n, size, 0);
+  run(n, size, 1);
+  exit(0);
+}